@@ -0,0 +1,51 @@
+/*
+ * anim_data.c
+ *
+ * Animation streams generated by tools/animc.py from:
+ *     assets/start_screen.anim
+ *
+ * Do not edit - edit the .anim files and rebuild instead.
+ */
+
+#include "anim_data.h"
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "anim_stream.h"
+#include "display.h"
+
+const uint8_t start_screen_anim[] PROGMEM = {
+	13, 3, 12,	// first column, columns, frames
+	0xF4, 0x01,	// frame time 500 ms
+	0x07, 0x00,	// frame 0
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(6, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(6, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 1
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 2
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(3, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x07, 0x00,	// frame 3
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(4, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(8, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 4
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 5
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(3, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x07, 0x00,	// frame 6
+		ANIM_RUN(6, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(6, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 7
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 8
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(3, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x07, 0x00,	// frame 9
+		ANIM_RUN(8, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(4, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 10
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(2, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+	0x02, 0x00,	// frame 11
+		ANIM_RUN(1, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(3, MATRIX_COLOUR_EMPTY), ANIM_RUN(1, MATRIX_COLOUR_BALL), ANIM_RUN(1, MATRIX_COLOUR_PLAYER), ANIM_RUN(1, MATRIX_COLOUR_EMPTY),
+};
@@ -0,0 +1,18 @@
+/*
+ * anim_data.h
+ *
+ * Animation streams generated by tools/animc.py. Play them with
+ * anim_stream_start() (see anim_stream.h).
+ *
+ * Do not edit - edit the .anim files and rebuild instead.
+ */
+
+#ifndef ANIM_DATA_H_
+#define ANIM_DATA_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+extern const uint8_t start_screen_anim[] PROGMEM;
+
+#endif /* ANIM_DATA_H_ */
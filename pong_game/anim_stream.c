@@ -0,0 +1,83 @@
+/*
+ * anim_stream.c
+ *
+ * See anim_stream.h for details.
+ */
+
+#include "anim_stream.h"
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "ledmatrix.h"
+
+#define STREAM_HEADER_BYTES (5)
+
+static const uint8_t* stream_start;
+static const uint8_t* next_frame;
+static uint8_t first_column;
+static uint8_t num_columns;
+static uint8_t num_frames;
+static uint16_t frame_time;
+static uint8_t looping;
+static uint32_t last_frame_time;
+
+// Number of frames still to draw before the end of the stream (0 when no
+// stream is playing)
+static uint8_t frames_remaining;
+
+void anim_stream_start(const uint8_t* stream, uint8_t loop,
+		uint32_t current_time) {
+	stream_start = stream;
+	next_frame = stream + STREAM_HEADER_BYTES;
+	first_column = pgm_read_byte(&stream[0]);
+	num_columns = pgm_read_byte(&stream[1]);
+	num_frames = pgm_read_byte(&stream[2]);
+	frame_time = pgm_read_byte(&stream[3]) | (pgm_read_byte(&stream[4]) << 8);
+	looping = loop;
+	frames_remaining = num_frames;
+	// Make the first frame due straight away
+	last_frame_time = current_time - frame_time;
+}
+
+uint8_t anim_stream_running(void) {
+	return frames_remaining != 0;
+}
+
+void anim_stream_stop(void) {
+	frames_remaining = 0;
+}
+
+void anim_stream_update(uint32_t current_time) {
+	if (frames_remaining == 0
+			|| current_time - last_frame_time < frame_time) {
+		return;
+	}
+	last_frame_time = current_time;
+
+	const uint8_t* data = next_frame;
+	uint16_t changed = pgm_read_byte(&data[0]) | (pgm_read_byte(&data[1]) << 8);
+	data += 2;
+	for (uint8_t i = 0; i < num_columns; i++, changed >>= 1) {
+		if (!(changed & 0x01)) {
+			continue;
+		}
+		// Expand the column's runs
+		MatrixColumn column;
+		uint8_t y = 0;
+		while (y < MATRIX_NUM_ROWS) {
+			uint8_t run = pgm_read_byte(data++);
+			PaletteIndex colour = run & 0x0F;
+			for (uint8_t length = (run >> 4) + 1;
+					length > 0 && y < MATRIX_NUM_ROWS; length--) {
+				column[y++] = colour;
+			}
+		}
+		ledmatrix_update_column(first_column + i, column);
+	}
+	next_frame = data;
+
+	frames_remaining--;
+	if (frames_remaining == 0 && looping) {
+		next_frame = stream_start + STREAM_HEADER_BYTES;
+		frames_remaining = num_frames;
+	}
+}
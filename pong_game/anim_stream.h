@@ -0,0 +1,50 @@
+/*
+ * anim_stream.h
+ *
+ * Plays animations stored in flash as compressed streams of frames. The
+ * streams are generated at build time from the .anim files in assets/ by
+ * tools/animc.py (see anim_data.h), so adding an animation costs flash
+ * rather than code.
+ *
+ * An animation draws a fixed range of columns of the display. Its stream
+ * is laid out as:
+ *
+ *     first column, number of columns (up to MATRIX_NUM_COLUMNS),
+ *     number of frames, frame time in milliseconds (2 bytes, low first)
+ *
+ * followed by each frame in turn:
+ *
+ *     a 2 byte mask (low byte first) with bit i set if column
+ *     first column + i changes in this frame - every column is included
+ *     in the first frame
+ *
+ *     for each column in the mask, lowest first, the column's pixels from
+ *     the bottom row up as runs of ANIM_RUN(length, colour) bytes
+ *
+ * Streams are played in the background: start one with anim_stream_start()
+ * and call anim_stream_update() from the main loop.
+ */
+
+#ifndef ANIM_STREAM_H_
+#define ANIM_STREAM_H_
+
+#include <stdint.h>
+
+// A run of length (1 to 16) pixels of the given palette index
+#define ANIM_RUN(length, colour) ((((length) - 1) << 4) | (colour))
+
+// Start playing a stream (in flash) from its first frame, which is drawn
+// straight away. If loop is non-zero the stream starts again from the
+// first frame after the last one, until anim_stream_stop() is called.
+void anim_stream_start(const uint8_t* stream, uint8_t loop,
+		uint32_t current_time);
+
+// Draw the next frame of the stream if it is due
+void anim_stream_update(uint32_t current_time);
+
+// Returns 1 if a stream is playing, 0 otherwise.
+uint8_t anim_stream_running(void);
+
+void anim_stream_stop(void);
+
+#endif /* ANIM_STREAM_H_ */
@@ -0,0 +1,94 @@
+/*
+ * animation.c
+ *
+ * See animation.h for details.
+ */
+
+#include "animation.h"
+#include <stdint.h>
+#include "ledmatrix.h"
+
+static AnimationType animation_type;
+static AnimationSource animation_source;
+static uint16_t animation_step_time;
+static uint32_t last_step_time;
+
+// Number of steps still to take (0 when no animation is running) and the
+// number already taken
+static uint8_t steps_remaining;
+static uint8_t step_number;
+
+void animation_start(AnimationType type, AnimationSource source,
+		uint16_t step_time, uint32_t current_time) {
+	animation_type = type;
+	animation_source = source;
+	animation_step_time = step_time;
+	step_number = 0;
+	if (type == ANIMATION_SLIDE_UP || type == ANIMATION_SLIDE_DOWN) {
+		steps_remaining = MATRIX_NUM_ROWS;
+	} else {
+		steps_remaining = MATRIX_NUM_COLUMNS;
+	}
+	// Make the first step due straight away
+	last_step_time = current_time - step_time;
+}
+
+uint8_t animation_running(void) {
+	return steps_remaining != 0;
+}
+
+// Copy column source_x of the new picture into column x of the display
+static void fill_column(uint8_t x, uint8_t source_x) {
+	MatrixColumn column;
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		column[y] = animation_source(source_x, y);
+	}
+	ledmatrix_update_column(x, column);
+}
+
+// Copy row source_y of the new picture into row y of the display
+static void fill_row(uint8_t y, uint8_t source_y) {
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		ledmatrix_update_pixel(x, y, animation_source(x, source_y));
+	}
+}
+
+void animation_update(uint32_t current_time) {
+	if (steps_remaining == 0
+			|| current_time - last_step_time < animation_step_time) {
+		return;
+	}
+	last_step_time = current_time;
+
+	// Each slide step shifts the display one place and then fills in
+	// the edge that was shifted in with the next column or row of the
+	// new picture, starting from the edge nearest the incoming side
+	uint8_t last_column = MATRIX_NUM_COLUMNS - 1;
+	uint8_t last_row = MATRIX_NUM_ROWS - 1;
+	switch (animation_type) {
+		case ANIMATION_SLIDE_LEFT:
+			ledmatrix_shift_display_left();
+			fill_column(last_column, step_number);
+			break;
+		case ANIMATION_SLIDE_RIGHT:
+			ledmatrix_shift_display_right();
+			fill_column(0, last_column - step_number);
+			break;
+		case ANIMATION_SLIDE_UP:
+			ledmatrix_shift_display_up();
+			fill_row(0, last_row - step_number);
+			break;
+		case ANIMATION_SLIDE_DOWN:
+			ledmatrix_shift_display_down();
+			fill_row(last_row, step_number);
+			break;
+		case ANIMATION_WIPE_LEFT_TO_RIGHT:
+			fill_column(step_number, step_number);
+			break;
+		case ANIMATION_WIPE_RIGHT_TO_LEFT:
+			fill_column(last_column - step_number, last_column - step_number);
+			break;
+	}
+	step_number++;
+	steps_remaining--;
+}
@@ -0,0 +1,53 @@
+/*
+ * animation.h
+ *
+ * Transitions on the LED matrix that bring a new picture onto the display
+ * one column (or row) at a time. Slides use the matrix's shift commands to
+ * move what is already shown, so each step costs a 2 byte shift command
+ * plus the new edge column or row, rather than a repaint of the display.
+ *
+ * Animations run in the background: start one with animation_start() and
+ * call animation_update() from the main loop until animation_running()
+ * returns 0. Nothing else should draw to the display while an animation
+ * is running.
+ */
+
+#ifndef ANIMATION_H_
+#define ANIMATION_H_
+
+#include <stdint.h>
+#include "ledmatrix.h"
+
+// Default time between animation steps in milliseconds
+#define ANIMATION_STEP_MS	(40)
+
+typedef enum {
+	// Current picture moves out to the left, new picture comes in from
+	// the right (and so on for the other directions)
+	ANIMATION_SLIDE_LEFT,
+	ANIMATION_SLIDE_RIGHT,
+	ANIMATION_SLIDE_UP,
+	ANIMATION_SLIDE_DOWN,
+	// New picture is drawn over the current one a column at a time,
+	// starting from the left or right edge. Nothing is shifted.
+	ANIMATION_WIPE_LEFT_TO_RIGHT,
+	ANIMATION_WIPE_RIGHT_TO_LEFT
+} AnimationType;
+
+// Returns the colour (palette index) of pixel (x, y) of the picture being
+// brought onto the display
+typedef PaletteIndex (*AnimationSource)(uint8_t x, uint8_t y);
+
+// Start an animation which brings the picture described by source onto
+// the display, taking one step every step_time milliseconds. Any
+// animation already running is abandoned where it is.
+void animation_start(AnimationType type, AnimationSource source,
+		uint16_t step_time, uint32_t current_time);
+
+// Carry out the next step of the running animation if it is due.
+void animation_update(uint32_t current_time);
+
+// Returns 1 if an animation is still running, 0 otherwise.
+uint8_t animation_running(void);
+
+#endif /* ANIMATION_H_ */
@@ -0,0 +1,77 @@
+/*
+ * board_config.h
+ *
+ * Compile-time geometry of the game: the size of the board and paddles, and
+ * where the board, its borders and the rally meters sit on the LED matrix.
+ * Everything in the game and HUD that depends on the layout is worked out
+ * from these, so a different arena can be built by defining BOARD_WIDTH,
+ * BOARD_HEIGHT, PLAYER_HEIGHT or GAME_BORDER_WIDTH (e.g. with -D) without
+ * changing any code.
+ *
+ * From left to right the layout is player 1's rally meter, the left border,
+ * the board, the right border and player 2's rally meter. The layout is
+ * centred on the LED matrix, and the board is centred vertically.
+ */
+
+#ifndef BOARD_CONFIG_H_
+#define BOARD_CONFIG_H_
+
+#include "ledmatrix.h"
+
+// Game board dimensions (x and y axis are as per LED matrix i.e. x is the
+// longer axis)
+#ifndef BOARD_WIDTH
+#define BOARD_WIDTH			(12)
+#endif
+#ifndef BOARD_HEIGHT
+#define BOARD_HEIGHT		(8)
+#endif
+#ifndef GAME_BORDER_WIDTH
+#define GAME_BORDER_WIDTH	(1)
+#endif
+#ifndef PLAYER_HEIGHT
+#define PLAYER_HEIGHT		(2)
+#endif
+#define RALLY_METER_WIDTH	(1)
+
+// Width of the whole layout and the matrix column it starts in
+#define BOARD_LAYOUT_WIDTH	(BOARD_WIDTH \
+		+ 2 * (GAME_BORDER_WIDTH + RALLY_METER_WIDTH))
+#define BOARD_LAYOUT_X		((MATRIX_NUM_COLUMNS - BOARD_LAYOUT_WIDTH) / 2)
+
+// Offset for the LED matrix to cater for any game border offset to the edge
+// of the LED matrix display (i.e. the matrix position of board square 0, 0)
+#define MATRIX_X_OFFSET		(BOARD_LAYOUT_X + RALLY_METER_WIDTH \
+		+ GAME_BORDER_WIDTH)
+#define MATRIX_Y_OFFSET		((MATRIX_NUM_ROWS - BOARD_HEIGHT) / 2)
+
+// Matrix columns of the borders, rally meters and the middle of the board
+// (the left hand column of the right half)
+#define LEFT_BORDER_X		(MATRIX_X_OFFSET - GAME_BORDER_WIDTH)
+#define RIGHT_BORDER_X		(MATRIX_X_OFFSET + BOARD_WIDTH)
+#define RALLY_METER_1_X		(BOARD_LAYOUT_X)
+#define RALLY_METER_2_X		(BOARD_LAYOUT_X + BOARD_LAYOUT_WIDTH - 1)
+#define BOARD_CENTRE_X		(MATRIX_X_OFFSET + BOARD_WIDTH / 2)
+
+// Rally meters run the height of the matrix, a pixel per paddle hit
+#define RALLY_METER_LENGTH	(MATRIX_NUM_ROWS)
+
+// Board y coordinate of the bottom of a paddle at the start of a game, and
+// the highest it can go
+#define PLAYER_START_Y		((BOARD_HEIGHT - PLAYER_HEIGHT) / 2)
+#define PLAYER_MAX_Y		(BOARD_HEIGHT - PLAYER_HEIGHT)
+
+#if BOARD_LAYOUT_WIDTH > MATRIX_NUM_COLUMNS
+#error "The board, borders and rally meters don't fit on the LED matrix"
+#endif
+#if BOARD_HEIGHT > MATRIX_NUM_ROWS
+#error "BOARD_HEIGHT must be at most MATRIX_NUM_ROWS"
+#endif
+#if PLAYER_HEIGHT < 1 || PLAYER_HEIGHT > BOARD_HEIGHT
+#error "PLAYER_HEIGHT must be from 1 to BOARD_HEIGHT"
+#endif
+#if BOARD_WIDTH < 4
+#error "BOARD_WIDTH must be at least 4"
+#endif
+
+#endif /* BOARD_CONFIG_H_ */
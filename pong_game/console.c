@@ -0,0 +1,182 @@
+/*
+ * console.c
+ *
+ * See console.h for details.
+ */
+
+#include "console.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "serialio.h"
+#include "terminalio.h"
+
+#define LINE_START	':'
+#define ESCAPE		'\x1b'
+#define DELETE		'\x7f'
+
+// A key and the command it gives
+typedef struct {
+	char key;
+	uint8_t command;
+	uint16_t argument;
+} ConsoleKey;
+
+static const ConsoleKey console_keys[] PROGMEM = {
+	{'w', CONSOLE_PADDLE_1_UP, 0},
+	{'s', CONSOLE_PADDLE_1_DOWN, 0},
+	{'d', CONSOLE_PADDLE_1_DOWN, 0},
+	{'o', CONSOLE_PADDLE_2_UP, 0},
+	{'k', CONSOLE_PADDLE_2_DOWN, 0},
+	{'l', CONSOLE_PADDLE_2_DOWN, 0},
+	{'1', CONSOLE_SPEED, 500},
+	{'2', CONSOLE_SPEED, 300},
+	{'3', CONSOLE_SPEED, 200},
+	{'4', CONSOLE_SPEED, 125},
+	{'p', CONSOLE_PAUSE, 0}
+};
+#define NUM_CONSOLE_KEYS (sizeof(console_keys) / sizeof(console_keys[0]))
+
+// A line command's name, the command it gives and the range of the number
+// that must follow the name (no number if max is 0)
+typedef struct {
+	char name[10];
+	uint8_t command;
+	uint16_t min;
+	uint16_t max;
+} ConsoleLineCommand;
+
+static const ConsoleLineCommand console_lines[] PROGMEM = {
+	{"speed", CONSOLE_SPEED, 20, 2000},
+	{"seed", CONSOLE_SEED, 0, 65535},
+	{"stats", CONSOLE_STATS, 0, 0},
+	{"reset", CONSOLE_RESET, 0, 0},
+	{"telemetry", CONSOLE_TELEMETRY, 0, 1}
+};
+#define NUM_CONSOLE_LINES (sizeof(console_lines) / sizeof(console_lines[0]))
+
+// The line being typed (if in_line is set). too_long is set if characters
+// were lost off the end of it since it was last shorter than the limit.
+static char line[CONSOLE_LINE_LENGTH + 1];
+static uint8_t line_length;
+static uint8_t in_line;
+static uint8_t too_long;
+
+void console_init(void) {
+	in_line = 0;
+}
+
+// Echo c in column i of the line (the ':' is column 0), or clear the line
+// from there if c is 0. Other output may have moved the cursor since the
+// last echo, so each echo moves it back first.
+static void echo(uint8_t i, char c) {
+	SerialClass previous_class = serial_set_class(SERIAL_NORMAL);
+	move_terminal_cursor(CONSOLE_ECHO_X + i, CONSOLE_ECHO_Y);
+	if (c) {
+		serial_put_char(c);
+	} else {
+		clear_to_end_of_line();
+	}
+	serial_set_class(previous_class);
+}
+
+static char lower_case(char c) {
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Work out the command on the line just typed
+static ConsoleCommand parse_line(uint16_t* argument) {
+	if (too_long) {
+		return CONSOLE_INVALID;
+	}
+	line[line_length] = '\0';
+
+	// Split the name from the rest of the line
+	char* rest = line;
+	while (*rest != '\0' && *rest != ' ') {
+		*rest = lower_case(*rest);
+		rest++;
+	}
+	if (*rest == ' ') {
+		*rest++ = '\0';
+	}
+	while (*rest == ' ') {
+		rest++;
+	}
+
+	for (uint8_t i = 0; i < NUM_CONSOLE_LINES; i++) {
+		const ConsoleLineCommand* command = &console_lines[i];
+		if (strcmp_P(line, command->name) != 0) {
+			continue;
+		}
+		uint16_t max = pgm_read_word(&command->max);
+		uint32_t value = 0;
+		uint8_t num_digits = 0;
+		for (; *rest >= '0' && *rest <= '9'; rest++, num_digits++) {
+			value = value * 10 + (*rest - '0');
+			if (value > max) {
+				return CONSOLE_INVALID;
+			}
+		}
+		while (*rest == ' ') {
+			rest++;
+		}
+		if (*rest != '\0' || (max != 0 && num_digits == 0)
+				|| value < pgm_read_word(&command->min)) {
+			return CONSOLE_INVALID;
+		}
+		*argument = value;
+		return pgm_read_byte(&command->command);
+	}
+	return CONSOLE_INVALID;
+}
+
+ConsoleCommand console_poll(uint16_t* argument) {
+	for (uint8_t i = 0; i < CONSOLE_SLICE_CHARS
+			&& serial_input_available(); i++) {
+		char c = fgetc(stdin);
+		if (in_line) {
+			if (c == '\n') {
+				in_line = 0;
+				echo(0, 0);
+				return parse_line(argument);
+			} else if (c == ESCAPE) {
+				in_line = 0;
+				echo(0, 0);
+			} else if (c == '\b' || c == DELETE) {
+				// The lost characters weren't echoed, so once the line is
+				// back under the limit it is just what the user sees
+				if (line_length > 0) {
+					line_length--;
+					too_long = 0;
+					echo(line_length + 1, 0);
+				}
+			} else if (line_length < CONSOLE_LINE_LENGTH) {
+				line[line_length++] = c;
+				if (c >= ' ' && c < DELETE) {
+					echo(line_length, c);
+				} else {
+					echo(line_length, '?');
+				}
+			} else {
+				too_long = 1;
+			}
+		} else if (c == LINE_START) {
+			in_line = 1;
+			line_length = 0;
+			too_long = 0;
+			echo(0, LINE_START);
+			echo(1, 0);
+		} else {
+			c = lower_case(c);
+			for (uint8_t k = 0; k < NUM_CONSOLE_KEYS; k++) {
+				if (pgm_read_byte(&console_keys[k].key) == c) {
+					*argument = pgm_read_word(&console_keys[k].argument);
+					return pgm_read_byte(&console_keys[k].command);
+				}
+			}
+			// Any other key is ignored
+		}
+	}
+	return CONSOLE_NONE;
+}
@@ -0,0 +1,66 @@
+/*
+ * console.h
+ *
+ * Commands typed on the serial terminal. Single keys act straight away (in
+ * upper or lower case):
+ *   w, s/d   move player 1's paddle up, down
+ *   o, k/l   move player 2's paddle up, down
+ *   1 - 4    set the game speed (500, 300, 200 or 125ms per ball move)
+ *   p        pause or resume the game
+ * A line starting with ':' is a command with a name and maybe a number,
+ * run when Enter is pressed (Backspace deletes, Escape abandons the line).
+ * The line is echoed at CONSOLE_ECHO_X, CONSOLE_ECHO_Y as it is typed:
+ *   :speed <ms>    set the ms per ball move (20 - 2000)
+ *   :seed <n>      seed the random numbers the game uses
+ *   :stats         show the SPI queue high water mark and full count,
+ *                  the frames deferred, the serial characters dropped
+ *                  and input overruns, then reset them
+ *   :reset         abandon this game and start a new one
+ *   :telemetry <n> turn the binary game state stream (see telemetry.h)
+ *                  on (1) or off (0)
+ * The keys and the line commands are looked up in tables in flash.
+ *
+ * console_poll() never waits for input. It reads at most
+ * CONSOLE_SLICE_CHARS characters a call, so a burst of typing can't hold up
+ * the main loop - the rest wait in the serial input buffer (see
+ * serialio.h) for the next call.
+ */
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+
+// Most characters read by one call of console_poll()
+#define CONSOLE_SLICE_CHARS		(4)
+
+// Longest line command (not counting the ':')
+#define CONSOLE_LINE_LENGTH		(16)
+
+// Terminal column and row where the line being typed is echoed
+#define CONSOLE_ECHO_X			(10)
+#define CONSOLE_ECHO_Y			(19)
+
+typedef enum {
+	CONSOLE_NONE,		// Nothing to do (yet)
+	CONSOLE_PADDLE_1_UP,
+	CONSOLE_PADDLE_1_DOWN,
+	CONSOLE_PADDLE_2_UP,
+	CONSOLE_PADDLE_2_DOWN,
+	CONSOLE_SPEED,		// Argument is the ms per ball move
+	CONSOLE_PAUSE,
+	CONSOLE_SEED,		// Argument is the seed
+	CONSOLE_STATS,
+	CONSOLE_RESET,
+	CONSOLE_TELEMETRY,	// Argument is 1 for on, 0 for off
+	CONSOLE_INVALID		// A line that isn't a valid command
+} ConsoleCommand;
+
+// Forget any partly typed line
+void console_init(void);
+
+// Read the next few characters of input. Returns the command they complete,
+// if any, with its number (if it has one) put in *argument.
+ConsoleCommand console_poll(uint16_t* argument);
+
+#endif /* CONSOLE_H_ */
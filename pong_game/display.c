@@ -7,142 +7,199 @@
 
 #include "display.h"
 #include <stdio.h>
+#include <avr/pgmspace.h>
 #include "pixel_colour.h"
 #include "ledmatrix.h"
 #include "game.h"
+#include "animation.h"
+#include "timer0.h"
+#include "sprite.h"
+#include "anim_stream.h"
+#include "anim_data.h"
+#include "text_scroll.h"
 
-// constant value used to display 'PONG' on launch
-static const uint8_t pong_display[MATRIX_NUM_COLUMNS] = 
-		{126, 72, 120, 127, 67, 127, 126, 64, 126, 127, 67, 79, 0, 2, 82, 64};
+// Sprites used to display 'PONG' on launch, one for each colour of the
+// title. Both cover the whole display.
+static const uint8_t title_red_columns[MATRIX_NUM_COLUMNS] PROGMEM = {
+	0x00, 0x00, 0x00, 0x7E, 0x42, 0x7E, 0x00, 0x00,
+	0x00, 0x7E, 0x42, 0x4E, 0x00, 0x00, 0x00, 0x00
+};
+static const uint8_t title_green_columns[MATRIX_NUM_COLUMNS] PROGMEM = {
+	0x7E, 0x48, 0x78, 0x00, 0x00, 0x00, 0x7E, 0x40,
+	0x7E, 0x00, 0x00, 0x00, 0x00, 0x02, 0x52, 0x40
+};
+static const SpriteAsset title_red PROGMEM =
+		{MATRIX_NUM_COLUMNS, MATRIX_NUM_ROWS, title_red_columns};
+static const SpriteAsset title_green PROGMEM =
+		{MATRIX_NUM_COLUMNS, MATRIX_NUM_ROWS, title_green_columns};
 
 // Fonts for LED Matrix score display
-// Stored as a 5 x 3 grid pattern going from Left-to-Right, Top-to-Bottom
-// Padded with a leading zero so that it fits into a 16-bit value
-static const uint16_t LED_DIGIT_FONTS[10] = {
-    0b0111101101101111, // 0
-    0b0010010010010010, // 1
-    0b0111100111001111, // 2
-    0b0111001111001111, // 3
-    0b0001001111101101, // 4
-    0b0111001111100111, // 5
-    0b0111101111100111, // 6
-    0b0001001001001111, // 7
-    0b0111101111101111, // 8
-    0b0111001111101111, // 9
+// Each digit is 3 columns wide and 5 rows high. Each column is stored left
+// to right as a bitmap of its 5 rows, with bit 0 the bottom row (the sprite
+// format - see sprite.h). score_digit_assets holds a sprite for each digit.
+#define SCORE_DIGIT_WIDTH	(3)
+#define SCORE_DIGIT_HEIGHT	(5)
+#define SCORE_DIGIT_Y		(MATRIX_Y_OFFSET \
+		+ (BOARD_HEIGHT - SCORE_DIGIT_HEIGHT + 1) / 2)
+static const uint8_t SCORE_DIGIT_COLUMNS[10][SCORE_DIGIT_WIDTH] PROGMEM = {
+	{0b11111, 0b10001, 0b11111}, // 0
+	{0b00000, 0b11111, 0b00000}, // 1
+	{0b10111, 0b10101, 0b11101}, // 2
+	{0b10101, 0b10101, 0b11111}, // 3
+	{0b11100, 0b00100, 0b11111}, // 4
+	{0b11101, 0b10101, 0b10111}, // 5
+	{0b11111, 0b10101, 0b10111}, // 6
+	{0b10000, 0b10000, 0b11111}, // 7
+	{0b11111, 0b10101, 0b11111}, // 8
+	{0b11101, 0b10101, 0b11111}  // 9
 };
+#define SCORE_DIGIT_ASSET(digit) \
+		{SCORE_DIGIT_WIDTH, SCORE_DIGIT_HEIGHT, SCORE_DIGIT_COLUMNS[digit]}
+static const SpriteAsset score_digit_assets[10] PROGMEM = {
+	SCORE_DIGIT_ASSET(0), SCORE_DIGIT_ASSET(1), SCORE_DIGIT_ASSET(2),
+	SCORE_DIGIT_ASSET(3), SCORE_DIGIT_ASSET(4), SCORE_DIGIT_ASSET(5),
+	SCORE_DIGIT_ASSET(6), SCORE_DIGIT_ASSET(7), SCORE_DIGIT_ASSET(8),
+	SCORE_DIGIT_ASSET(9)
+};
+
+// Left hand column of each player's score digit on the matrix - either side
+// of the middle of the board, SCORE_DIGIT_GAP columns apart
+#define SCORE_DIGIT_GAP		(2)
+static const uint8_t score_digit_x[2] = {
+	BOARD_CENTRE_X - SCORE_DIGIT_GAP / 2 - SCORE_DIGIT_WIDTH,
+	BOARD_CENTRE_X + SCORE_DIGIT_GAP / 2
+};
+#if BOARD_WIDTH < 2 * SCORE_DIGIT_WIDTH + SCORE_DIGIT_GAP \
+		|| BOARD_HEIGHT < SCORE_DIGIT_HEIGHT
+#error "The board is too small to show the scores"
+#endif
+
+// Each player's score digit. The digits are drawn on the HUD layer, so the
+// game shows through again when they are removed. The sprites only repaint
+// what has changed, so redrawing an unchanged score costs nothing.
+static Sprite score_digits[2];
+
+// Colour of each of the MATRIX_COLOUR_* palette entries
+static const PixelColour display_palette[MATRIX_NUM_COLOURS] PROGMEM = {
+	COLOUR_BLACK,			// MATRIX_COLOUR_EMPTY
+	COLOUR_LIGHT_YELLOW,	// MATRIX_COLOUR_BORDER
+	COLOUR_GREEN,			// MATRIX_COLOUR_PLAYER
+	COLOUR_RED,				// MATRIX_COLOUR_BALL
+	COLOUR_RALLY,			// MATRIX_COLOUR_RALLY
+	COLOUR_SCORE,			// MATRIX_COLOUR_SCORE
+	COLOUR_RED,				// MATRIX_COLOUR_TITLE_RED
+	COLOUR_GREEN,			// MATRIX_COLOUR_TITLE_GREEN
+	COLOUR_ORANGE,			// MATRIX_COLOUR_TEXT
+	COLOUR_BALL_SHADE_1,	// MATRIX_COLOUR_BALL_SHADE_1
+	COLOUR_BALL_SHADE_2,	// MATRIX_COLOUR_BALL_SHADE_2
+	COLOUR_BALL_SHADE_3,	// MATRIX_COLOUR_BALL_SHADE_3
+	COLOUR_EFFECT_SHADE_1,	// MATRIX_COLOUR_EFFECT_1
+	COLOUR_EFFECT_SHADE_2,	// MATRIX_COLOUR_EFFECT_2
+	COLOUR_EFFECT_SHADE_3,	// MATRIX_COLOUR_EFFECT_3
+	COLOUR_EFFECT_SHADE_4	// MATRIX_COLOUR_EFFECT_4
+};
+
+// How urgently changes to each colour are sent to the LED matrix, so the
+// ball and paddles are never held up behind the HUD or decoration
+static const uint8_t display_priority[MATRIX_NUM_COLOURS] PROGMEM = {
+	LEDMATRIX_PRIORITY_DECORATION,	// MATRIX_COLOUR_EMPTY
+	LEDMATRIX_PRIORITY_DECORATION,	// MATRIX_COLOUR_BORDER
+	LEDMATRIX_PRIORITY_GAMEPLAY,	// MATRIX_COLOUR_PLAYER
+	LEDMATRIX_PRIORITY_GAMEPLAY,	// MATRIX_COLOUR_BALL
+	LEDMATRIX_PRIORITY_HUD,			// MATRIX_COLOUR_RALLY
+	LEDMATRIX_PRIORITY_HUD,			// MATRIX_COLOUR_SCORE
+	LEDMATRIX_PRIORITY_DECORATION,	// MATRIX_COLOUR_TITLE_RED
+	LEDMATRIX_PRIORITY_DECORATION,	// MATRIX_COLOUR_TITLE_GREEN
+	LEDMATRIX_PRIORITY_HUD,			// MATRIX_COLOUR_TEXT
+	LEDMATRIX_PRIORITY_GAMEPLAY,	// MATRIX_COLOUR_BALL_SHADE_1
+	LEDMATRIX_PRIORITY_GAMEPLAY,	// MATRIX_COLOUR_BALL_SHADE_2
+	LEDMATRIX_PRIORITY_GAMEPLAY,	// MATRIX_COLOUR_BALL_SHADE_3
+	LEDMATRIX_PRIORITY_DECORATION,	// MATRIX_COLOUR_EFFECT_1
+	LEDMATRIX_PRIORITY_DECORATION,	// MATRIX_COLOUR_EFFECT_2
+	LEDMATRIX_PRIORITY_DECORATION,	// MATRIX_COLOUR_EFFECT_3
+	LEDMATRIX_PRIORITY_DECORATION	// MATRIX_COLOUR_EFFECT_4
+};
+
+// Palette entry for each brightness of the ball, from empty to full
+static const uint8_t ball_shades[BALL_NUM_SHADES + 1] PROGMEM = {
+	MATRIX_COLOUR_EMPTY, MATRIX_COLOUR_BALL_SHADE_1, MATRIX_COLOUR_BALL_SHADE_2,
+	MATRIX_COLOUR_BALL_SHADE_3, MATRIX_COLOUR_BALL
+};
+
+void initialise_palette(void) {
+	for (uint8_t i = 1; i < MATRIX_NUM_COLOURS; i++) {
+		ledmatrix_set_palette_colour(i, pgm_read_byte(&display_palette[i]));
+		ledmatrix_set_palette_priority(i, pgm_read_byte(&display_priority[i]));
+	}
+}
 
 // Initialise the display for the board, this creates the display
 // for an empty board.
 void initialise_display(void) {
-	// start by clearing the LED matrix
+	// start by clearing the LED matrix (the HUD layer as well as the game)
+	ledmatrix_draw_to(LEDMATRIX_LAYER_HUD);
 	ledmatrix_clear();
+	ledmatrix_draw_to(LEDMATRIX_LAYER_GAME);
+	ledmatrix_clear();
+	for (uint8_t player = 0; player < 2; player++) {
+		sprite_init(&score_digits[player], NULL, score_digit_x[player],
+				SCORE_DIGIT_Y, MATRIX_COLOUR_SCORE);
+	}
 
 	// create an array with the background colour at every position
-	PixelColour col_colours[MATRIX_NUM_ROWS];
+	PaletteIndex col_colours[MATRIX_NUM_ROWS];
 	for (int row = 0; row < MATRIX_NUM_ROWS; row++) {
 		col_colours[row] = MATRIX_COLOUR_BORDER;
 	}
 
 	// then add the bounds on the left
-	for (int x = 1; x < 1 + GAME_BORDER_WIDTH; x++) {
+	for (int x = LEFT_BORDER_X; x < LEFT_BORDER_X + GAME_BORDER_WIDTH; x++) {
 		ledmatrix_update_column(x, col_colours);
 	}
 
 	// and add the bounds on the right
-	for (int x = 14; x < 14 + GAME_BORDER_WIDTH; x++) {
+	for (int x = RIGHT_BORDER_X; x < RIGHT_BORDER_X + GAME_BORDER_WIDTH;
+			x++) {
 		ledmatrix_update_column(x, col_colours);
 	}
 }
 
-void show_start_screen(void) {
-	PixelColour colour;
-	MatrixColumn column_colour_data;
-	uint8_t col_data;
-		
-	ledmatrix_clear(); // start by clearing the LED matrix
-	for (uint8_t col = 0; col < MATRIX_NUM_COLUMNS; col++) {
-		col_data = pong_display[col];
-		// using the LSB as the colour determining bit, 1 is red, 0 is green
-		if (col_data & 0x01) {
-			colour = COLOUR_RED;
-		} else {
-			colour = COLOUR_GREEN;
-		}
-		// go through the top 7 bits (not the bottom one as that was our colour bit)
-		// and set any to be the correct colour
-		for(uint8_t i = 7; i >= 1; i--) {
-			// If the relevant font bit is set, we make this a coloured pixel, else blank
-			if(col_data & 0x80) {
-				column_colour_data[i] = colour;
-			} else {
-				column_colour_data[i] = 0;
-			}
-			col_data <<= 1;
-		}
-		column_colour_data[0] = 0;
-		ledmatrix_update_column(col, column_colour_data);
-	}
-		// Update pong ball colour
-	ledmatrix_update_pixel(START_SCREEN_BALL_X, START_SCREEN_BALL_Y, MATRIX_COLOUR_BALL);
-}
-
-// Update dynamic start screen based on the frame number (0-11)
-// Note: this is hardcoded to PONG game.
-// Purposefully obfuscated so functionality cannot be copied for movement tasks
-void update_start_screen(uint8_t frame_number) {
-	
-	if (frame_number < 0 || frame_number > 11) {
-		return;
+// Colour of pixel (x, y) of the start screen
+static PaletteIndex start_screen_pixel(uint8_t x, uint8_t y) {
+	if (x == START_SCREEN_BALL_X && y == START_SCREEN_BALL_Y) {
+		return MATRIX_COLOUR_BALL;
 	}
-	
-	// Clear the dynamic columns
-	MatrixColumn column_colour_data[PONG_NUM_DYNAMIC_COLS];
-	for (uint8_t col = 0; col < PONG_NUM_DYNAMIC_COLS; col++) {
-		for (uint8_t row = 0; row < MATRIX_NUM_ROWS; row++) {
-			column_colour_data[col][row] = 0;
-		}
+	if (sprite_asset_pixel(&title_red, x, y)) {
+		return MATRIX_COLOUR_TITLE_RED;
 	}
-	
-	// Set the middle paddle pixel
-	column_colour_data[1][6] = MATRIX_COLOUR_PLAYER;
-	column_colour_data[1][1] = MATRIX_COLOUR_PLAYER;
-	
-	// Set the edge paddle pixel depending on frame number
-	if (frame_number < 3 || frame_number >= 9) {
-		column_colour_data[2][6] = MATRIX_COLOUR_PLAYER;
-	} else {
-		column_colour_data[0][6] = MATRIX_COLOUR_PLAYER;
-	}
-	if (frame_number < 6) {
-		column_colour_data[0][1] = MATRIX_COLOUR_PLAYER;
-	} else {
-		column_colour_data[2][1] = MATRIX_COLOUR_PLAYER;
-	}
-	
-	// Set the ball pixel depending on frame number
-	if (frame_number == 5 || frame_number == 11) {
-		column_colour_data[1][5] = MATRIX_COLOUR_BALL;
-	} else if (frame_number == 0 || frame_number == 4 || frame_number == 6
-			|| frame_number == 10) {
-		column_colour_data[1][4] = MATRIX_COLOUR_BALL;
-	} else if (frame_number == 1 || frame_number == 3 || frame_number == 7
-			|| frame_number == 9) {
-		column_colour_data[1][3] = MATRIX_COLOUR_BALL;
-	} else {
-		column_colour_data[1][2] = MATRIX_COLOUR_BALL;
+	if (sprite_asset_pixel(&title_green, x, y)) {
+		return MATRIX_COLOUR_TITLE_GREEN;
 	}
+	return MATRIX_COLOUR_EMPTY;
+}
 
-	// Update columns
-	for (uint8_t col = 0; col < PONG_NUM_DYNAMIC_COLS; col++) {
-		ledmatrix_update_column(col + PONG_DYNAMIC_COL_START, column_colour_data[col]);
+void show_start_screen(void) {
+	anim_stream_stop();
+	text_scroll_stop();
+	// Slide the start screen in from the right over whatever is showing
+	animation_start(ANIMATION_SLIDE_LEFT, start_screen_pixel,
+			ANIMATION_STEP_MS, get_current_time());
+}
+
+// Play the animation at the right of the start screen (generated from
+// assets/start_screen.anim) on a loop
+void update_start_screen(uint32_t current_time) {
+	if (!anim_stream_running()) {
+		anim_stream_start(start_screen_anim, 1, current_time);
 	}
+	anim_stream_update(current_time);
 }
 
 // Update the colour of the pixel at position (x, y) on the display to show the
 // provided object
 void update_square_colour(uint8_t x, uint8_t y, uint8_t object) {
 	// determine which colour corresponds to this object
-	PixelColour colour;
+	PaletteIndex colour;
 	
 	switch (object) {
 		case EMPTY_SQUARE:
@@ -164,56 +221,73 @@ void update_square_colour(uint8_t x, uint8_t y, uint8_t object) {
 	ledmatrix_update_pixel(x + MATRIX_X_OFFSET, y + MATRIX_Y_OFFSET, colour);
 }
 
-//int8_t p1_led_score = p1score;
-//int8_t p2_led_score = p1score;
+void update_ball_square(uint8_t x, uint8_t y, uint8_t shade) {
+	if (shade > BALL_NUM_SHADES) {
+		shade = BALL_NUM_SHADES;
+	}
+	ledmatrix_update_pixel(x + MATRIX_X_OFFSET, y + MATRIX_Y_OFFSET,
+			pgm_read_byte(&ball_shades[shade]));
+}
+
+// Set the digit shown in a player's score position
+static void set_score_digit(uint8_t player, int8_t score) {
+	if ((uint8_t)score <= 9) {
+		sprite_set_asset(&score_digits[player], &score_digit_assets[score]);
+	}
+}
+
+// Update the score digits on the HUD layer
+static void update_score_digits(void) {
+	LedMatrixLayer previous_layer = ledmatrix_draw_to(LEDMATRIX_LAYER_HUD);
+	for (uint8_t player = 0; player < 2; player++) {
+		sprite_update(&score_digits[player]);
+	}
+	ledmatrix_draw_to(previous_layer);
+}
+
 void led_matrix_score(void) {
-	int p1_led_score[16];
-	int p2_led_score[16];
-	int n = 0;
-	int m = 0;
-	for (int x = 0; x < 15; x++) {
-		p1_led_score[x] = !!(LED_DIGIT_FONTS[p1score] & (1 << x));
-		p2_led_score[x] = !!(LED_DIGIT_FONTS[p2score] & (1 << x));
-	}
-	for (int y = 6; y > 1; y--) {
-		for (int x = 6; x >= 4; x--) {
-			/*if (p1_led_score[n] == 0) {
-				ledmatrix_update_pixel(x, y, COLOUR_BLACK);
-				n++;
-			}*/
-			if (p1_led_score[n] == 1) {
-				ledmatrix_update_pixel(x, y, COLOUR_SCORE);
-				n++;
-			} else{
-			n++;
-			}
-		}
-	}
-	for (int y = 6; y > 1; y--) {
-		for (int x = 11; x >= 9; x--) {
-			/*if (p2_led_score[m] == 0) {
-				ledmatrix_update_pixel(q, w, COLOUR_BLACK);
-				w++;
-			}*/
-			if (p2_led_score[m] == 1) {
-				ledmatrix_update_pixel(x, y, COLOUR_SCORE);
-				m++;
-			}else{
-			m++;
-			}
-		}
-	}	
+	set_score_digit(0, p1score);
+	set_score_digit(1, p2score);
+	update_score_digits();
 }
 
+// Remove the score overlay, uncovering the game underneath
 void led_matrix_score_clear(void) {
-	for (int y = 6; y > 1; y--) {
-		for (int x = 6; x >= 4; x--) {
-			ledmatrix_update_pixel(x, y, COLOUR_BLACK);
-		}
+	for (uint8_t player = 0; player < 2; player++) {
+		sprite_set_asset(&score_digits[player], NULL);
+	}
+	update_score_digits();
+}
+
+// Colour of pixel (x, y) of the score screen - the same digits that
+// led_matrix_score() draws, on a black background
+static PaletteIndex score_screen_pixel(uint8_t x, uint8_t y) {
+	uint8_t score;
+	uint8_t col;
+	if (x >= score_digit_x[0] && x < score_digit_x[0] + SCORE_DIGIT_WIDTH) {
+		score = p1score;
+		col = x - score_digit_x[0];
+	} else if (x >= score_digit_x[1]
+			&& x < score_digit_x[1] + SCORE_DIGIT_WIDTH) {
+		score = p2score;
+		col = x - score_digit_x[1];
+	} else {
+		return MATRIX_COLOUR_EMPTY;
 	}
-	for (int w = 6; w > 1; w--) {
-		for (int q = 11; q >= 9; q--) {
-			ledmatrix_update_pixel(q, w, COLOUR_BLACK);
-		}
+	if (score > 9) {
+		return MATRIX_COLOUR_EMPTY;
 	}
+	return sprite_asset_pixel(&score_digit_assets[score], col,
+			y - SCORE_DIGIT_Y) ? MATRIX_COLOUR_SCORE : MATRIX_COLOUR_EMPTY;
+}
+
+void show_score_screen(void) {
+	// Scroll the score up onto the display
+	animation_start(ANIMATION_SLIDE_UP, score_screen_pixel,
+			ANIMATION_STEP_MS, get_current_time());
+}
+
+void show_winner_text(void) {
+	text_scroll_start((p1score > p2score) ? PSTR("P1 WINS") : PSTR("P2 WINS"),
+			MATRIX_COLOUR_TEXT, TEXT_SCROLL_STEP_MS, get_current_time());
 }
@@ -8,38 +8,62 @@
 #ifndef DISPLAY_H_
 #define DISPLAY_H_
 
+#include <stdint.h>
 #include "pixel_colour.h"
+#include "board_config.h"
 
-// Offset for the LED matrix to cater for any game border offset to the edge
-// of the LED matrix display.
-#define MATRIX_X_OFFSET 2
-#define MATRIX_Y_OFFSET 0
+// Matrix colour definitions. These are palette indices - the colour of
+// each is set by initialise_palette() (see display.c).
+#define MATRIX_COLOUR_EMPTY		(0)
+#define MATRIX_COLOUR_BORDER	(1)
+#define MATRIX_COLOUR_PLAYER	(2)
+#define MATRIX_COLOUR_BALL		(3)
+#define MATRIX_COLOUR_RALLY		(4)
+#define MATRIX_COLOUR_SCORE		(5)
+#define MATRIX_COLOUR_TITLE_RED		(6)
+#define MATRIX_COLOUR_TITLE_GREEN	(7)
+#define MATRIX_COLOUR_TEXT		(8)
+#define MATRIX_COLOUR_BALL_SHADE_1	(9)
+#define MATRIX_COLOUR_BALL_SHADE_2	(10)
+#define MATRIX_COLOUR_BALL_SHADE_3	(11)
+// Effects shades, faintest first (see effects.h)
+#define MATRIX_COLOUR_EFFECT_1	(12)
+#define MATRIX_COLOUR_EFFECT_2	(13)
+#define MATRIX_COLOUR_EFFECT_3	(14)
+#define MATRIX_COLOUR_EFFECT_4	(15)
+#define MATRIX_NUM_COLOURS		(16)
 
-// Matrix colour definitions
-#define MATRIX_COLOUR_EMPTY		COLOUR_BLACK
-#define MATRIX_COLOUR_BORDER	COLOUR_LIGHT_YELLOW
-#define MATRIX_COLOUR_PLAYER	COLOUR_GREEN
-#define MATRIX_COLOUR_BALL		COLOUR_RED
+// Number of brightness steps the ball can be drawn with, from off (0) to
+// MATRIX_COLOUR_BALL (BALL_NUM_SHADES)
+#define BALL_NUM_SHADES			(4)
 
 #define START_SCREEN_BALL_X		(14)
 #define START_SCREEN_BALL_Y		(4)
 
-#define PONG_NUM_DYNAMIC_COLS	(3)
-#define PONG_DYNAMIC_COL_START	(13)
+// Load the game's colours into the LED matrix palette. Must be called
+// after ledmatrix_setup() and before anything is drawn.
+void initialise_palette(void);
+
 // Initialise the display for the board, this creates the display
 // for an empty board.
 void initialise_display(void);
 
-// Shows a starting display.
+// Shows a starting display. The display slides in as an animation (see
+// animation.h) - call animation_update() until it has finished.
 void show_start_screen(void);
 
-// Update dynamic start screen based on frame number (0-11)
-void update_start_screen(uint8_t frame_number);
+// Update the moving part of the start screen. Call this from the main loop
+// once show_start_screen()'s animation has finished.
+void update_start_screen(uint32_t current_time);
 
 // Updates the colour at square (x, y) to be the colour
 // of the object 'object'.
 void update_square_colour(uint8_t x, uint8_t y, uint8_t object);
 
+// Updates square (x, y) to show part of the ball, at a brightness from 0
+// (empty) to BALL_NUM_SHADES (the full ball colour).
+void update_ball_square(uint8_t x, uint8_t y, uint8_t shade);
+
 //uint16_t LED_DIGIT_FONTS[10];
 
 
@@ -47,5 +71,13 @@ void update_square_colour(uint8_t x, uint8_t y, uint8_t object);
 void led_matrix_score(void);
 void led_matrix_score_clear(void);
 
+// Scroll a screen showing both scores up onto the display as an
+// animation (see animation.h)
+void show_score_screen(void);
+
+// Scroll the name of the winning player across the display (see
+// text_scroll.h) - call text_scroll_update() until it has finished.
+void show_winner_text(void);
+
 
 #endif /* DISPLAY_H_ */
@@ -0,0 +1,188 @@
+/*
+ * effects.c
+ *
+ * See effects.h for details.
+ */
+
+#include "effects.h"
+#include <stdint.h>
+#include <stddef.h>
+#include "ledmatrix.h"
+#include "display.h"
+#include "game.h"
+
+// Columns are tracked as bits of a uint16_t
+#if BOARD_WIDTH > 16
+#error "Effects support boards up to 16 columns wide"
+#endif
+
+// Estimated SPI bytes to change one pixel, or a whole column, of the LED
+// matrix (see ledmatrix.c)
+#define PIXEL_BYTES		(3)
+#define COLUMN_BYTES	(2 + MATRIX_NUM_ROWS)
+
+typedef struct {
+	int8_t x;
+	int8_t y;
+	uint8_t shade;				// 0 when the particle isn't in use
+	uint8_t frames_per_shade;
+	uint8_t frames_left;		// until the particle fades a shade
+} Particle;
+
+static Particle particles[EFFECTS_MAX_PARTICLES];
+
+void effects_clear(void) {
+	for (uint8_t i = 0; i < EFFECTS_MAX_PARTICLES; i++) {
+		particles[i].shade = 0;
+	}
+	LedMatrixLayer previous_layer = ledmatrix_draw_to(LEDMATRIX_LAYER_EFFECTS);
+	ledmatrix_clear();
+	ledmatrix_draw_to(previous_layer);
+}
+
+// Start a particle at square (x, y) which fades from shade over
+// frames_per_shade frames for each shade. A particle already in that
+// square is brightened instead.
+static void spawn(int8_t x, int8_t y, uint8_t shade,
+		uint8_t frames_per_shade) {
+	if (x < 0 || x >= BOARD_WIDTH || y < 0 || y >= BOARD_HEIGHT) {
+		return;
+	}
+	Particle* slot = NULL;
+	for (uint8_t i = 0; i < EFFECTS_MAX_PARTICLES; i++) {
+		Particle* particle = &particles[i];
+		if (particle->shade != 0 && particle->x == x && particle->y == y) {
+			slot = particle;
+			if (shade < slot->shade) {
+				return;
+			}
+			break;
+		}
+		if (slot == NULL || particle->shade < slot->shade) {
+			slot = particle;
+		}
+	}
+	if (slot->shade > shade) {
+		// Every particle is brighter than this one would be
+		return;
+	}
+	slot->x = x;
+	slot->y = y;
+	slot->shade = shade;
+	slot->frames_per_shade = frames_per_shade;
+	slot->frames_left = frames_per_shade;
+}
+
+void effects_ball_trail(int8_t x, int8_t y) {
+	spawn(x, y, 2, 3);
+}
+
+void effects_paddle_spark(int8_t x, int8_t y, int8_t direction) {
+	spawn(x, y + 1, 4, 2);
+	spawn(x, y - 1, 4, 2);
+	spawn(x + direction, y + 2, 3, 2);
+	spawn(x + direction, y - 2, 3, 2);
+}
+
+void effects_goal_flash(int8_t x) {
+	for (int8_t y = 0; y < BOARD_HEIGHT; y++) {
+		spawn(x, y, EFFECTS_NUM_SHADES, 4);
+	}
+}
+
+// Shade of square (x, y) as drawn on the effects layer
+static uint8_t drawn_shade(int8_t x, int8_t y) {
+	PaletteIndex pixel = ledmatrix_get_pixel(x + MATRIX_X_OFFSET,
+			y + MATRIX_Y_OFFSET);
+	if (pixel < MATRIX_COLOUR_EFFECT_1) {
+		return 0;
+	}
+	return pixel - MATRIX_COLOUR_EFFECT_1 + 1;
+}
+
+void effects_update(void) {
+	// Fade the particles, and work out the shade each square should be
+	uint8_t shades[BOARD_WIDTH][BOARD_HEIGHT] = {{0}};
+	for (uint8_t i = 0; i < EFFECTS_MAX_PARTICLES; i++) {
+		Particle* particle = &particles[i];
+		if (particle->shade == 0) {
+			continue;
+		}
+		if (--particle->frames_left == 0) {
+			particle->shade--;
+			particle->frames_left = particle->frames_per_shade;
+		}
+		if (particle->shade > shades[particle->x][particle->y]) {
+			shades[particle->x][particle->y] = particle->shade;
+		}
+	}
+
+	LedMatrixLayer previous_layer = ledmatrix_draw_to(LEDMATRIX_LAYER_EFFECTS);
+
+	// Find how much each column has changed by: the cost of redrawing it
+	// and the brightest square changing in it (0 if none are)
+	uint8_t column_cost[BOARD_WIDTH];
+	uint8_t column_visibility[BOARD_WIDTH];
+	for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+		uint8_t changes = 0;
+		column_visibility[x] = 0;
+		for (int8_t y = 0; y < BOARD_HEIGHT; y++) {
+			uint8_t drawn = drawn_shade(x, y);
+			if (shades[x][y] != drawn) {
+				changes++;
+				if (drawn > column_visibility[x]) {
+					column_visibility[x] = drawn;
+				}
+				if (shades[x][y] > column_visibility[x]) {
+					column_visibility[x] = shades[x][y];
+				}
+			}
+		}
+		column_cost[x] = (changes * PIXEL_BYTES < COLUMN_BYTES)
+				? changes * PIXEL_BYTES : COLUMN_BYTES;
+	}
+
+	// Redraw the most visible changes first, skipping any that don't fit
+	// in what is left of the frame's bytes. Columns are marked as dealt
+	// with by clearing their visibility, and those skipped are noted in
+	// skipped_columns (bit x for column x).
+	uint8_t bytes = 0;
+	uint16_t skipped_columns = 0;
+	while (1) {
+		int8_t best = -1;
+		for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+			if (column_visibility[x] != 0 && (best < 0
+					|| column_visibility[x] > column_visibility[best])) {
+				best = x;
+			}
+		}
+		if (best < 0) {
+			break;
+		}
+		column_visibility[best] = 0;
+		if (bytes + column_cost[best] > EFFECTS_FRAME_BYTES) {
+			skipped_columns |= ((uint16_t)1 << best);
+			continue;
+		}
+		for (int8_t y = 0; y < BOARD_HEIGHT; y++) {
+			ledmatrix_update_pixel(best + MATRIX_X_OFFSET, y + MATRIX_Y_OFFSET,
+					shades[best][y]
+					? MATRIX_COLOUR_EFFECT_1 + shades[best][y] - 1
+					: PALETTE_BLACK);
+		}
+		bytes += column_cost[best];
+	}
+
+	// Particles which should have appeared in skipped columns are dropped.
+	// Those already showing carry on, and catch up in a later frame.
+	for (uint8_t i = 0; i < EFFECTS_MAX_PARTICLES; i++) {
+		Particle* particle = &particles[i];
+		if (particle->shade != 0
+				&& (skipped_columns & ((uint16_t)1 << particle->x))
+				&& drawn_shade(particle->x, particle->y) == 0) {
+			particle->shade = 0;
+		}
+	}
+
+	ledmatrix_draw_to(previous_layer);
+}
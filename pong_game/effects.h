@@ -0,0 +1,57 @@
+/*
+ * effects.h
+ *
+ * Short lived effects on the LED matrix: a trail behind the ball, sparks
+ * where the ball hits a paddle and a flash down the goal line when a point
+ * is scored. They are drawn on the effects layer, under the game (see
+ * ledmatrix.h), so they never cover anything the game draws.
+ *
+ * Effects are made of particles - single squares of the game board which
+ * start at a brightness (shade) and fade a shade at a time over a number
+ * of frames. Particles come from a fixed pool. When it is full a new
+ * particle takes the place of the faintest one, or is dropped if it would
+ * be fainter than all of them.
+ *
+ * effects_update() fades the particles and redraws the squares that have
+ * changed. The LED matrix commands this takes are capped at
+ * EFFECTS_FRAME_BYTES a frame: the board's columns are redrawn brightest
+ * change first, each as whichever of pixel or column commands is cheaper,
+ * until the cap is reached. The rest wait for a later frame, and particles
+ * that would have appeared in them are dropped. Effects are also sent at
+ * decoration priority, so the LED matrix always sends gameplay pixels
+ * first.
+ */
+
+#ifndef EFFECTS_H_
+#define EFFECTS_H_
+
+#include <stdint.h>
+
+#define EFFECTS_MAX_PARTICLES	(16)
+
+// Number of shades a particle can have (see MATRIX_COLOUR_EFFECT_* in
+// display.h)
+#define EFFECTS_NUM_SHADES		(4)
+
+// LED matrix SPI bytes the effects may use each frame
+#ifndef EFFECTS_FRAME_BYTES
+#define EFFECTS_FRAME_BYTES		(24)
+#endif
+
+// Remove every particle and clear the effects layer
+void effects_clear(void);
+
+// Start effects. Positions are squares of the game board.
+// A short trail left behind by the ball as it moves out of square (x, y)
+void effects_ball_trail(int8_t x, int8_t y);
+// Sparks around the ball at (x, y) as it bounces off a paddle, thrown in
+// the direction (LEFT or RIGHT) it bounces
+void effects_paddle_spark(int8_t x, int8_t y, int8_t direction);
+// A flash down column x of the board
+void effects_goal_flash(int8_t x);
+
+// Fade the particles and redraw what has changed, within the frame's cap.
+// Call this once per frame.
+void effects_update(void);
+
+#endif /* EFFECTS_H_ */
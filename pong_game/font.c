@@ -0,0 +1,111 @@
+/*
+ * font.c
+ *
+ * See font.h for details.
+ */
+
+#include "font.h"
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#define FONT_FIRST_CHAR (' ')
+#define FONT_LAST_CHAR ('Z')
+#define FONT_NUM_GLYPHS (FONT_LAST_CHAR - FONT_FIRST_CHAR + 1)
+
+// The columns of every glyph, one after another
+static const uint8_t font_columns[] PROGMEM = {
+	0x00, 0x00,	// space
+	0x1D,	// !
+	0x18, 0x00, 0x18,	// "
+	0x0A, 0x1F, 0x0A, 0x1F, 0x0A,	// #
+	0x09, 0x1F, 0x12,	// $
+	0x13, 0x04, 0x08, 0x11,	// %
+	0x0A, 0x15, 0x0A, 0x05,	// &
+	0x18,	// '
+	0x0E, 0x11,	// (
+	0x11, 0x0E,	// )
+	0x0A, 0x04, 0x0A,	// *
+	0x04, 0x0E, 0x04,	// +
+	0x01, 0x02,	// ,
+	0x04, 0x04, 0x04,	// -
+	0x01,	// .
+	0x03, 0x04, 0x18,	// /
+	0x1F, 0x11, 0x1F,	// 0
+	0x08, 0x1F,	// 1
+	0x17, 0x15, 0x1D,	// 2
+	0x11, 0x15, 0x1F,	// 3
+	0x1C, 0x04, 0x1F,	// 4
+	0x1D, 0x15, 0x17,	// 5
+	0x1F, 0x15, 0x17,	// 6
+	0x10, 0x13, 0x1C,	// 7
+	0x1F, 0x15, 0x1F,	// 8
+	0x1D, 0x15, 0x1F,	// 9
+	0x0A,	// :
+	0x01, 0x0A,	// ;
+	0x04, 0x0A, 0x11,	// <
+	0x0A, 0x0A, 0x0A,	// =
+	0x11, 0x0A, 0x04,	// >
+	0x10, 0x15, 0x1C,	// ?
+	0x0E, 0x11, 0x15, 0x0C,	// @
+	0x0F, 0x14, 0x0F,	// A
+	0x1F, 0x15, 0x0A,	// B
+	0x0E, 0x11, 0x11,	// C
+	0x1F, 0x11, 0x0E,	// D
+	0x1F, 0x15, 0x11,	// E
+	0x1F, 0x14, 0x10,	// F
+	0x0E, 0x11, 0x15, 0x16,	// G
+	0x1F, 0x04, 0x1F,	// H
+	0x11, 0x1F, 0x11,	// I
+	0x02, 0x01, 0x1E,	// J
+	0x1F, 0x04, 0x1B,	// K
+	0x1F, 0x01, 0x01,	// L
+	0x1F, 0x08, 0x04, 0x08, 0x1F,	// M
+	0x1F, 0x08, 0x04, 0x1F,	// N
+	0x0E, 0x11, 0x11, 0x0E,	// O
+	0x1F, 0x14, 0x08,	// P
+	0x0E, 0x11, 0x12, 0x0D,	// Q
+	0x1F, 0x14, 0x0B,	// R
+	0x09, 0x15, 0x12,	// S
+	0x10, 0x1F, 0x10,	// T
+	0x1F, 0x01, 0x1F,	// U
+	0x1E, 0x01, 0x1E,	// V
+	0x1F, 0x02, 0x04, 0x02, 0x1F,	// W
+	0x1B, 0x04, 0x1B,	// X
+	0x18, 0x07, 0x18,	// Y
+	0x13, 0x15, 0x19,	// Z
+};
+
+// Index in font_columns of the first column of each glyph. The entry after
+// a glyph's marks its end, so its width is the difference between them.
+static const uint8_t font_offsets[FONT_NUM_GLYPHS + 1] PROGMEM = {
+	0, 2, 3, 6, 11, 14, 18, 22, 23, 25, 27, 30,
+	33, 35, 38, 39, 42, 45, 47, 50, 53, 56, 59, 62,
+	65, 68, 71, 72, 74, 77, 80, 83, 86, 90, 93, 96,
+	99, 102, 105, 108, 112, 115, 118, 121, 124, 127, 132, 136,
+	140, 143, 147, 150, 153, 156, 159, 162, 167, 170, 173, 176
+};
+
+// Index into the font tables of the glyph for character c
+static uint8_t glyph_index(char c) {
+	if (c >= 'a' && c <= 'z') {
+		c -= 'a' - 'A';
+	}
+	if (c < FONT_FIRST_CHAR || c > FONT_LAST_CHAR) {
+		c = '?';
+	}
+	return c - FONT_FIRST_CHAR;
+}
+
+uint8_t font_glyph_width(char c) {
+	uint8_t glyph = glyph_index(c);
+	return pgm_read_byte(&font_offsets[glyph + 1])
+			- pgm_read_byte(&font_offsets[glyph]);
+}
+
+uint8_t font_glyph_column(char c, uint8_t col) {
+	if (col >= font_glyph_width(c)) {
+		return 0;
+	}
+	return pgm_read_byte(
+			&font_columns[pgm_read_byte(&font_offsets[glyph_index(c)]) + col]);
+}
@@ -0,0 +1,31 @@
+/*
+ * font.h
+ *
+ * A proportional font for the LED matrix, stored in flash. Glyphs are
+ * FONT_HEIGHT pixels high and 1 to 5 columns wide. Each column is a bitmap
+ * of its pixels with bit 0 the bottom row (the sprite format - see
+ * sprite.h).
+ *
+ * The font covers the printable ASCII characters from space to 'Z'.
+ * Lower case letters are shown in upper case and any other character is
+ * shown as '?'.
+ */
+
+#ifndef FONT_H_
+#define FONT_H_
+
+#include <stdint.h>
+
+#define FONT_HEIGHT (5)
+
+// Blank columns to leave between one glyph and the next
+#define FONT_GLYPH_SPACING (1)
+
+// Returns the number of columns in the glyph for character c
+uint8_t font_glyph_width(char c);
+
+// Returns column col (0 being the leftmost) of the glyph for character c,
+// or 0 if col is beyond the glyph's width
+uint8_t font_glyph_column(char c, uint8_t col);
+
+#endif /* FONT_H_ */
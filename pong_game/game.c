@@ -26,6 +26,12 @@
 // LED MATRIX SCORE
 #include "display.h"
 
+// paddles
+#include "sprite.h"
+
+// trails, sparks and goal flashes
+#include "effects.h"
+
 // Seven Seg Display
 /* Seven segment display segment values for 0 to 9 */
 uint8_t seven_seg_data[10] = {63,6,91,79,102,109,125,7,127,111};
@@ -37,6 +43,12 @@ int8_t seven_seg_cc = 0;
 static const int8_t PLAYER_X_COORDINATES[] = {PLAYER_1_X, PLAYER_2_X};
 static int8_t player_y_coordinates[] = {0, 0};
 
+// Paddle sprites, positioned in LED matrix coordinates
+static const uint8_t PADDLE_COLUMNS[] PROGMEM = {(1 << PLAYER_HEIGHT) - 1};
+static const SpriteAsset PADDLE_ASSET PROGMEM =
+		{1, PLAYER_HEIGHT, PADDLE_COLUMNS};
+static Sprite paddle_sprites[2];
+
 // Ball position
 int8_t ball_x;
 int8_t ball_y;
@@ -45,6 +57,20 @@ int8_t ball_y;
 int8_t ball_x_direction;
 int8_t ball_y_direction;
 
+// Smooth ball motion. The ball is drawn BALL_SUBSTEPS steps of the way
+// from the square it last moved from to the square it is in now, lighting
+// the (up to) four squares around that point in proportion to how close
+// it is to each. The squares lit (as a 2x2 box with its bottom left at
+// drawn_ball_x, drawn_ball_y) and how brightly are remembered so they can
+// be erased. After a jump (e.g. the ball being reset) the ball is drawn
+// straight at its new square.
+#define BALL_SUBSTEPS		(4)
+static int8_t prev_ball_x;
+static int8_t prev_ball_y;
+static int8_t drawn_ball_x;
+static int8_t drawn_ball_y;
+static uint8_t drawn_ball_shades[2][2];
+
 // Player Score
 int8_t p1score;
 int8_t p2score;
@@ -53,6 +79,10 @@ int8_t p2score;
 int8_t p1rally;
 int8_t p2rally;
 
+// Rally meters are drawn on the HUD layer in the outside column on each
+// player's side of the board (see board_config.h)
+static const uint8_t RALLY_METER_X[] = {RALLY_METER_1_X, RALLY_METER_2_X};
+
 //uint16_t LED_DIGIT_FONTS[10];
 
 int8_t ret_player_1_score(void) {
@@ -62,6 +92,19 @@ int8_t ret_player_2_score(void) {
 	return p2score;
 }
 
+void get_game_state(GameState* state) {
+	state->ball_x = ball_x;
+	state->ball_y = ball_y;
+	state->ball_x_direction = ball_x_direction;
+	state->ball_y_direction = ball_y_direction;
+	state->paddle_y[PLAYER_1] = player_y_coordinates[PLAYER_1];
+	state->paddle_y[PLAYER_2] = player_y_coordinates[PLAYER_2];
+	state->score[PLAYER_1] = p1score;
+	state->score[PLAYER_2] = p2score;
+	state->rally[PLAYER_1] = p1rally;
+	state->rally[PLAYER_2] = p2rally;
+}
+
 // Randomise Direction
 /* Takes current time as the seed, creates a random int 0 or 1, multiplies it by 2, negates it then adds 1
    1) 1 -> 2 -> -2 -> -1
@@ -92,18 +135,28 @@ void rand_y_direction(void) {
 }
 
 void draw_player_paddle(uint8_t player_to_draw);
-void erase_player_paddle(uint8_t player_to_draw);
+static uint8_t paddle_covers(uint8_t player, int8_t y);
+void draw_rally_meter(uint8_t player);
+void draw_ball(uint8_t substep);
 
 // Initialise the player paddles, ball and display to start a game of PONG.
 void initialise_game(void) {
 	
 	// initialise the display we are using.
 	initialise_display();
+	effects_clear();
 
 	// Start players in the middle of the board
-	player_y_coordinates[PLAYER_1] = BOARD_HEIGHT / 2 - 1;
-	player_y_coordinates[PLAYER_2] = BOARD_HEIGHT / 2 - 1;
+	player_y_coordinates[PLAYER_1] = PLAYER_START_Y;
+	player_y_coordinates[PLAYER_2] = PLAYER_START_Y;
 
+	// The display has just been cleared, so the paddles start undrawn
+	for (uint8_t player = PLAYER_1; player <= PLAYER_2; player++) {
+		sprite_init(&paddle_sprites[player], &PADDLE_ASSET,
+				PLAYER_X_COORDINATES[player] + MATRIX_X_OFFSET,
+				player_y_coordinates[player] + MATRIX_Y_OFFSET,
+				MATRIX_COLOUR_PLAYER);
+	}
 	draw_player_paddle(PLAYER_1);
 	draw_player_paddle(PLAYER_2);
 	// Player Score
@@ -114,12 +167,16 @@ void initialise_game(void) {
 	p1rally = 0;
 	p2rally = 0;
 
-	// Clear the old ball
-	update_square_colour(ball_x, ball_y, EMPTY_SQUARE);
-	
-	// Reset ball position and direction
+	// Reset ball position and direction. The display has just been
+	// cleared, so there is no old ball to erase.
 	ball_x = BALL_START_X;
 	ball_y = BALL_START_Y;
+	prev_ball_x = ball_x;
+	prev_ball_y = ball_y;
+	for (uint8_t i = 0; i < 2; i++) {
+		drawn_ball_shades[i][0] = 0;
+		drawn_ball_shades[i][1] = 0;
+	}
 	
 	srand(get_current_time());
 	
@@ -130,43 +187,45 @@ void initialise_game(void) {
 	ball_y_direction = UP; */
 	
 	// Draw new ball
-	update_square_colour(ball_x, ball_y, BALL);
+	draw_ball(BALL_SUBSTEPS);
 }
 
 // Draw player 1 or 2 on the game board at their current position (specified
 // by the `PLAYER_X_COORDINATES` and `player_y_coordinates` variables).
-// This makes it easier to draw the multiple pixels of the players.
+// Only the pixels the paddle has moved out of or into are repainted.
 void draw_player_paddle(uint8_t player_to_draw) {
-	int8_t player_x = PLAYER_X_COORDINATES[player_to_draw];
-	int8_t player_y = player_y_coordinates[player_to_draw];
-
-	for (int y = player_y; y < player_y + PLAYER_HEIGHT; y++) {
-		update_square_colour(player_x, y, PLAYER);
-	}
+	Sprite* paddle = &paddle_sprites[player_to_draw];
+	sprite_move(paddle, PLAYER_X_COORDINATES[player_to_draw] + MATRIX_X_OFFSET,
+			player_y_coordinates[player_to_draw] + MATRIX_Y_OFFSET);
+	sprite_update(paddle);
 }
 
-// Erase the pixels of player 1 or 2 from the display.
-void erase_player_paddle(uint8_t player_to_draw) {
-	int8_t player_x = PLAYER_X_COORDINATES[player_to_draw];
-	int8_t player_y = player_y_coordinates[player_to_draw];
-
-	for (int y = player_y; y < player_y + PLAYER_HEIGHT; y++) {
-		update_square_colour(player_x, y, EMPTY_SQUARE);
+// Draw a player's rally meter - one pixel for each paddle hit in the
+// current rally, from the bottom of the display up. The whole column is
+// redrawn, so a meter is emptied in one go.
+void draw_rally_meter(uint8_t player) {
+	int8_t rally = (player == PLAYER_1) ? p1rally : p2rally;
+	MatrixColumn meter;
+	for (uint8_t y = 0; y < RALLY_METER_LENGTH; y++) {
+		meter[y] = (y < rally) ? MATRIX_COLOUR_RALLY : MATRIX_COLOUR_EMPTY;
 	}
+	LedMatrixLayer previous_layer = ledmatrix_draw_to(LEDMATRIX_LAYER_HUD);
+	ledmatrix_update_column(RALLY_METER_X[player], meter);
+	ledmatrix_draw_to(previous_layer);
 }
 
 void move_player_paddle(int8_t player, int8_t direction) {
 	 int8_t new_player_position;
 	 new_player_position = player_y_coordinates[player] + direction;
-	 // Checks if the ball is in the same location as the new_player_position
-	 if ((((ball_x == 0) & (ball_y == new_player_position)) | ((ball_x == 0) & (ball_y == new_player_position + 1))) 
-	 | (((ball_x == BOARD_WIDTH - 1) & (ball_y == new_player_position)) | ((ball_x == BOARD_WIDTH - 1) & (ball_y == new_player_position + 1)))) {
+	 // Checks if the ball is in a paddle column, where the paddle would move to
+	 if (((ball_x == PLAYER_1_X) | (ball_x == PLAYER_2_X))
+			 & (ball_y >= new_player_position)
+			 & (ball_y < new_player_position + PLAYER_HEIGHT)) {
 		// Do Nothing
 		;
 	 } else {
 		 // Allows the player to move as long as the new position does not go out of bounds
-		 if ((new_player_position >= 0) & (new_player_position < (BOARD_HEIGHT - 1))) {
-			 erase_player_paddle(player);
+		 if ((new_player_position >= 0) & (new_player_position <= PLAYER_MAX_Y)) {
 			 player_y_coordinates[player] = new_player_position;
 			 draw_player_paddle(player);
 		 }
@@ -199,17 +258,12 @@ void update_ball_position(void) {
 		rand_y_direction();
 		// Increase Player 2 Score
 		p2score += 1;
-		move_terminal_cursor(66,10);
-		printf_P(PSTR("%d"), p2score);
+		effects_goal_flash(PLAYER_1_X);
 		// Reset Rally Count
 		p1rally = 0;
 		p2rally = 0;
-		ledmatrix_update_pixel(0, 0, COLOUR_BLACK);
-		ledmatrix_update_pixel(15, 0, COLOUR_BLACK);
-		for (int8_t y = 0; y += 1;) {
-			ledmatrix_update_pixel(0, y, COLOUR_BLACK);
-			ledmatrix_update_pixel(15, y, COLOUR_BLACK);
-		}
+		draw_rally_meter(PLAYER_1);
+		draw_rally_meter(PLAYER_2);
 	
 	}
 	// Player 1 Score
@@ -223,66 +277,155 @@ void update_ball_position(void) {
 		rand_y_direction();
 		// Increase Player 1 Score
 		p1score += 1;
-		move_terminal_cursor(26,10);
-		printf_P(PSTR("%d"), p1score);
+		effects_goal_flash(PLAYER_2_X);
 		// Reset Rally Count
 		p1rally = 0;
 		p2rally = 0;
-		ledmatrix_update_pixel(0, 0, COLOUR_BLACK);
-		ledmatrix_update_pixel(15, 0, COLOUR_BLACK);
-		for (int8_t y = 0; y += 1;) {
-			ledmatrix_update_pixel(0, y, COLOUR_BLACK);
-			ledmatrix_update_pixel(15, y, COLOUR_BLACK);
-		}
+		draw_rally_meter(PLAYER_1);
+		draw_rally_meter(PLAYER_2);
 	}
 	
 	
 	// Paddle Bouncin'
 	// Player 1
-	if ((new_ball_x == PLAYER_X_COORDINATES[0]) & ((new_ball_y == player_y_coordinates[PLAYER_1]) | (new_ball_y == player_y_coordinates[PLAYER_1] + 1))) {
+	if ((new_ball_x == PLAYER_X_COORDINATES[0]) & paddle_covers(PLAYER_1, new_ball_y)) {
 		rand_y_direction();
 		ball_x_direction *= -1;
 		new_ball_x = ball_x + ball_x_direction;
 		new_ball_y = ball_y + ball_y_direction;
+		effects_paddle_spark(ball_x, ball_y, ball_x_direction);
 		p1rally += 1;
-		if (p1rally % 9 != 0) {
-			ledmatrix_update_pixel(0, p1rally - 1, COLOUR_RALLY);	
-		} else {
+		if (p1rally % (RALLY_METER_LENGTH + 1) == 0) {
+			// Meter is full - start again from the bottom
 			p1rally = 1;
-			for (int8_t y = 0; y += 1;) {
-				//printf_P(PSTR("%d"), y);
-				ledmatrix_update_pixel(0, y, COLOUR_BLACK);	
-			}
 		}
+		draw_rally_meter(PLAYER_1);
 	}
 	// Player 2
-	if ((new_ball_x == PLAYER_X_COORDINATES[1]) & ((new_ball_y == player_y_coordinates[PLAYER_2]) | (new_ball_y == player_y_coordinates[PLAYER_2] + 1))) {
+	if ((new_ball_x == PLAYER_X_COORDINATES[1]) & paddle_covers(PLAYER_2, new_ball_y)) {
 		rand_y_direction();
 		ball_x_direction *= -1;
 		new_ball_x = ball_x + ball_x_direction;
 		new_ball_y = ball_y + ball_y_direction;
+		effects_paddle_spark(ball_x, ball_y, ball_x_direction);
 		p2rally += 1;
-		if (p2rally % 9 != 0) {
-			ledmatrix_update_pixel(15, p2rally - 1, COLOUR_RALLY);
-			} else {
+		if (p2rally % (RALLY_METER_LENGTH + 1) == 0) {
+			// Meter is full - start again from the bottom
 			p2rally = 1;
-			for (int8_t y = 0; y += 1;) {
-				// int8_t y = 0; y += 1;
-				//int8_t y = 0; y < 9; y++
-				// why work
-				ledmatrix_update_pixel(15, y, COLOUR_BLACK);
-			}
 		}
+		draw_rally_meter(PLAYER_2);
+	}
+	// Assign new ball coordinates. The ball glides from its old square
+	// unless it has jumped (or smooth motion is off).
+	if (BALL_SMOOTH_MOTION && abs(new_ball_x - ball_x) <= 1
+			&& abs(new_ball_y - ball_y) <= 1) {
+		prev_ball_x = ball_x;
+		prev_ball_y = ball_y;
+		effects_ball_trail(ball_x, ball_y);
+	} else {
+		prev_ball_x = new_ball_x;
+		prev_ball_y = new_ball_y;
 	}
-	// Erase old ball
-	update_square_colour(ball_x, ball_y, EMPTY_SQUARE);
-	
-	// Assign new ball coordinates
 	ball_x = new_ball_x;
 	ball_y = new_ball_y;
 	
-	// Draw new ball
-	update_square_colour(ball_x, ball_y, BALL);
+	// Draw new ball (which starts where the old one was, if it glides)
+	draw_ball(0);
+}
+
+// Returns 1 if a player's paddle covers row y of its column, 0 otherwise
+static uint8_t paddle_covers(uint8_t player, int8_t y) {
+	return y >= player_y_coordinates[player]
+			&& y < player_y_coordinates[player] + PLAYER_HEIGHT;
+}
+
+// Returns 1 if square (x, y) is part of a player's paddle, 0 otherwise
+static uint8_t paddle_at(int8_t x, int8_t y) {
+	for (uint8_t player = PLAYER_1; player <= PLAYER_2; player++) {
+		if (x == PLAYER_X_COORDINATES[player] && paddle_covers(player, y)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Set the brightness of one square of the ball. Squares off the board or
+// covered by a paddle are left alone.
+static void draw_ball_square(int8_t x, int8_t y, uint8_t shade) {
+	if (x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT
+			&& !paddle_at(x, y)) {
+		update_ball_square(x, y, shade);
+	}
+}
+
+// Returns the brightness the ball was last drawn with in square (x, y)
+static uint8_t drawn_ball_shade(int8_t x, int8_t y) {
+	int8_t i = x - drawn_ball_x;
+	int8_t j = y - drawn_ball_y;
+	if (i < 0 || i > 1 || j < 0 || j > 1) {
+		return 0;
+	}
+	return drawn_ball_shades[i][j];
+}
+
+// Draw the ball substep steps (out of BALL_SUBSTEPS) of the way from its
+// previous square to its current one
+void draw_ball(uint8_t substep) {
+	// Position of the ball in 1/BALL_SUBSTEPS of a square, and how much of
+	// it falls in each column and row of the box of squares around it
+	int8_t x = prev_ball_x * BALL_SUBSTEPS + (ball_x - prev_ball_x) * substep;
+	int8_t y = prev_ball_y * BALL_SUBSTEPS + (ball_y - prev_ball_y) * substep;
+	int8_t box_x = x / BALL_SUBSTEPS;
+	int8_t box_y = y / BALL_SUBSTEPS;
+	uint8_t x_weights[2] = {BALL_SUBSTEPS - x % BALL_SUBSTEPS,
+			x % BALL_SUBSTEPS};
+	uint8_t y_weights[2] = {BALL_SUBSTEPS - y % BALL_SUBSTEPS,
+			y % BALL_SUBSTEPS};
+	uint8_t shades[2][2];
+	for (uint8_t i = 0; i < 2; i++) {
+		for (uint8_t j = 0; j < 2; j++) {
+			shades[i][j] = (x_weights[i] * y_weights[j] * BALL_NUM_SHADES
+					+ BALL_SUBSTEPS * BALL_SUBSTEPS / 2)
+					/ (BALL_SUBSTEPS * BALL_SUBSTEPS);
+		}
+	}
+
+	// Erase the squares that are no longer lit, then draw those whose
+	// brightness has changed
+	for (uint8_t i = 0; i < 2; i++) {
+		for (uint8_t j = 0; j < 2; j++) {
+			int8_t dx = drawn_ball_x + i - box_x;
+			int8_t dy = drawn_ball_y + j - box_y;
+			uint8_t still_lit = (dx >= 0 && dx <= 1 && dy >= 0 && dy <= 1)
+					&& shades[dx][dy] != 0;
+			if (drawn_ball_shades[i][j] != 0 && !still_lit) {
+				draw_ball_square(drawn_ball_x + i, drawn_ball_y + j, 0);
+			}
+		}
+	}
+	for (uint8_t i = 0; i < 2; i++) {
+		for (uint8_t j = 0; j < 2; j++) {
+			if (shades[i][j] != 0 && shades[i][j]
+					!= drawn_ball_shade(box_x + i, box_y + j)) {
+				draw_ball_square(box_x + i, box_y + j, shades[i][j]);
+			}
+		}
+	}
+
+	drawn_ball_x = box_x;
+	drawn_ball_y = box_y;
+	for (uint8_t i = 0; i < 2; i++) {
+		drawn_ball_shades[i][0] = shades[i][0];
+		drawn_ball_shades[i][1] = shades[i][1];
+	}
+}
+
+void update_ball_motion(uint32_t elapsed, uint16_t step_time) {
+	if (elapsed >= step_time) {
+		draw_ball(BALL_SUBSTEPS);
+	} else {
+		draw_ball(elapsed * BALL_SUBSTEPS / step_time);
+	}
 }
 
 // Returns 1 if the game is over, 0 otherwise.
@@ -13,6 +13,7 @@
 #define GAME_H_
 
 #include <stdint.h>
+#include "board_config.h"
 
 // Ball directions
 #define LEFT				(-1)
@@ -24,15 +25,9 @@
 #define BALL_START_X_DIR	(RIGHT)
 #define BALL_START_Y_DIR	(STATIONARY)
 
-// Game board dimensions (x and y axis are as per LED matrix i.e. x is the
-// longer axis)
-#define BOARD_WIDTH			(12)
-#define BOARD_HEIGHT		(8)
-#define GAME_BORDER_WIDTH	(1)
-
+// Game board dimensions are set in board_config.h
 #define PLAYER_1_X			(0)
 #define PLAYER_2_X			(BOARD_WIDTH - 1)
-#define PLAYER_HEIGHT		(2)
 
 #define BALL_START_X		(BOARD_WIDTH / 2 - 1)
 #define BALL_START_Y		(BOARD_HEIGHT / 2)
@@ -40,6 +35,15 @@
 #define PLAYER_1			(0)
 #define PLAYER_2			(1)
 
+// Smooth ball motion. When BALL_SMOOTH_MOTION is non-zero the ball is drawn
+// gliding from one square to the next between moves, its brightness split
+// across the squares it is between (see update_ball_motion()). Otherwise
+// it jumps a whole square at each move. Either way the game itself only
+// ever sees whole squares.
+#ifndef BALL_SMOOTH_MOTION
+#define BALL_SMOOTH_MOTION	(1)
+#endif
+
 // Game objects
 #define EMPTY_SQUARE		(0)
 #define PLAYER				(1)
@@ -58,6 +62,11 @@ void move_player_paddle(int8_t player, int8_t direction);
 // Update ball position based on current x direction and y direction of ball
 void update_ball_position(void);
 
+// Redraw the ball elapsed milliseconds into a move between squares which
+// takes step_time milliseconds. Only squares whose brightness has changed
+// are redrawn. Call this once per frame.
+void update_ball_motion(uint32_t elapsed, uint16_t step_time);
+
 
 // Returns 1 if the game is over, 0 otherwise.
 uint8_t is_game_over(void);
@@ -67,6 +76,20 @@ int8_t inc_player_score(int8_t player_score);
 char score_convert(int8_t player_score);
 int8_t ret_player_1_score(void);
 int8_t ret_player_2_score(void);
+
+// A snapshot of everything that changes during a game, in board
+// coordinates. Arrays are indexed by player.
+typedef struct {
+	int8_t ball_x;
+	int8_t ball_y;
+	int8_t ball_x_direction;
+	int8_t ball_y_direction;
+	int8_t paddle_y[2];
+	int8_t score[2];
+	int8_t rally[2];
+} GameState;
+
+void get_game_state(GameState* state);
 #endif
 
 // SSD
@@ -4,12 +4,31 @@
  * Author: Peter Sutton
  *
  * See the LED matrix Reference for details of the SPI commands used.
+ *
+ * The update functions below do not talk to the matrices directly. They
+ * change one of the layer buffers (layers) which together hold what we want
+ * the surface to show. ledmatrix_flush() lays the part of the layers in
+ * the viewport over each other, a panel at a time (composed), and compares
+ * the result with a shadow copy of what each panel is actually showing
+ * (shadow). It sends only the pixels that differ, using whichever command
+ * takes the least time on the SPI link. All the buffers hold palette
+ * indices - the palette is used to look up the colour of each pixel as it
+ * is sent.
  */
 
 #include "ledmatrix.h"
 #include <stdint.h>
 #include <avr/io.h>
 #include "spi.h"
+#include "timer0.h"
+
+#if LEDMATRIX_NUM_PANELS > SPI_NUM_DEVICES
+#error "Each LED matrix panel needs its own SPI device - see SPI_NUM_DEVICES"
+#endif
+#if (MATRIX_NUM_COLUMNS < LEDMATRIX_VIEW_COLUMNS) \
+		|| (MATRIX_NUM_COLUMNS % 2) || (MATRIX_NUM_COLUMNS > 254)
+#error "MATRIX_NUM_COLUMNS must be even, at most 254 and cover the panels"
+#endif
 
 #define CMD_UPDATE_ALL		(0x00)
 #define CMD_UPDATE_PIXEL	(0x01)
@@ -18,30 +37,192 @@
 #define CMD_SHIFT_DISPLAY	(0x04)
 #define CMD_CLEAR_SCREEN	(0x0F)
 
+// Number of SPI bytes each command to a panel costs
+#define CLEAR_COMMAND_BYTES		(1)
+#define PIXEL_COMMAND_BYTES		(3)
+#define SHIFT_COMMAND_BYTES		(2)
+#define COLUMN_COMMAND_BYTES	(2 + MATRIX_NUM_ROWS)
+#define ROW_COMMAND_BYTES		(2 + LEDMATRIX_PANEL_COLUMNS)
+
+#define ALL_COMMAND_BYTES		(1 + LEDMATRIX_PANEL_COLUMNS * MATRIX_NUM_ROWS)
+
+// Dividing the SPI clock by 128 is always safe - the matrix can keep up
+// with any command stream at that speed. Faster than that, an update all
+// command is too long to send in one burst, so it isn't used: a panel that
+// has changed throughout is sent as row and column commands like any other
+// changes.
+#define SAFE_SPI_DIVIDER		(128)
+#define USE_UPDATE_ALL			(LEDMATRIX_SPI_DIVIDER >= SAFE_SPI_DIVIDER)
+
+// Time each command takes on the SPI link, in microseconds. A byte takes 8
+// x LEDMATRIX_SPI_DIVIDER clock cycles - LEDMATRIX_SPI_DIVIDER microseconds
+// at 8MHz - and the command gap follows every command. ALL_COMMAND_US is
+// the time to send the whole of a panel, which is a row command for each
+// row when the update all command isn't used.
+#define COMMAND_US(bytes) \
+		((bytes) * (uint16_t)LEDMATRIX_SPI_DIVIDER + LEDMATRIX_COMMAND_GAP_US)
+#define CLEAR_COMMAND_US	COMMAND_US(CLEAR_COMMAND_BYTES)
+#define PIXEL_COMMAND_US	COMMAND_US(PIXEL_COMMAND_BYTES)
+#define SHIFT_COMMAND_US	COMMAND_US(SHIFT_COMMAND_BYTES)
+#define COLUMN_COMMAND_US	COMMAND_US(COLUMN_COMMAND_BYTES)
+#define ROW_COMMAND_US		COMMAND_US(ROW_COMMAND_BYTES)
+#if USE_UPDATE_ALL
+#define ALL_COMMAND_US		COMMAND_US(ALL_COMMAND_BYTES)
+#else
+#define ALL_COMMAND_US		(MATRIX_NUM_ROWS * ROW_COMMAND_US)
+#endif
+
+// The display layers (each covering the whole surface), what we want each
+// panel to show (the layers composed at the last flush), and what each
+// panel is showing. Pixels are stored as 4 bit palette indices, two to a
+// byte, in the order the matrix expects them in an update all command: row
+// by row from y = 0, and from x = 0 along each row. The pixel with the
+// even x value of each pair is in the low nibble. draw_layer is the layer
+// the update functions change (layer number draw_layer_number).
+// viewport_x is the surface column shown in the left column of panel 0.
+#define PANEL_ROW_BYTES (LEDMATRIX_PANEL_COLUMNS / 2)
+#define SURFACE_ROW_BYTES (MATRIX_NUM_COLUMNS / 2)
+typedef uint8_t PanelFrame[MATRIX_NUM_ROWS][PANEL_ROW_BYTES];
+typedef uint8_t SurfaceFrame[MATRIX_NUM_ROWS][SURFACE_ROW_BYTES];
+static SurfaceFrame layers[LEDMATRIX_NUM_LAYERS];
+static PanelFrame composed[LEDMATRIX_NUM_PANELS];
+static PanelFrame shadow[LEDMATRIX_NUM_PANELS];
+static uint8_t (*draw_layer)[SURFACE_ROW_BYTES] = layers[LEDMATRIX_LAYER_GAME];
+static LedMatrixLayer draw_layer_number = LEDMATRIX_LAYER_GAME;
+static uint8_t viewport_x;
+
+// The colour sent to the matrix for each palette index. Index 0 is always
+// black (the matrix's clear screen colour). stale_palette_entries has a bit
+// set for each entry that has changed colour since the last flush. The
+// flush turns these into bits in resend_pixels (bit x of element y for
+// pixel (x, y) of each panel) for the pixels that have to be resent in the
+// new colour, which stay set until those pixels are sent - possibly
+// several flushes later, if sending is deferred.
+static PixelColour palette[LEDMATRIX_PALETTE_SIZE];
+static uint16_t stale_palette_entries;
+static uint16_t resend_pixels[LEDMATRIX_NUM_PANELS][MATRIX_NUM_ROWS];
+
+// The LedMatrixPriority of pixels of each palette index. Black has the
+// lowest priority, so that a pixel being blanked takes the priority of
+// the colour it had. Other entries are gameplay unless set otherwise.
+static uint8_t palette_priority[LEDMATRIX_PALETTE_SIZE] =
+		{LEDMATRIX_PRIORITY_DECORATION};
+
+// Set whenever a layer is changed so ledmatrix_flush() can return straight
+// away when there is nothing to do.
+static uint8_t frame_changed;
+
+// Per frame SPI statistics. shift_us is the time taken by the shift
+// commands sent since the last frame was committed (they are sent
+// immediately rather than at flush time).
+static uint16_t shift_us;
+static LedMatrixFrameStats frame_stats;
+
+// Set by ledmatrix_flush() when it had to leave changes for a later frame
+// to stay within the frame budget
+static uint8_t flush_deferred;
+
+// Background scrub - see ledmatrix_commit_frame(). scrub_row of
+// scrub_panel is the next row to resend.
+static uint8_t scrub_panel;
+static uint8_t scrub_row;
+static uint8_t frames_since_scrub;
+
 void ledmatrix_setup(void) {
-	// Setup SPI - we divide the clock by 128.
-	// (This speed guarantees the SPI buffer will never overflow on
-	// the LED matrix.)
-	spi_setup_master(128);
+	// Setup SPI - we divide the clock by LEDMATRIX_SPI_DIVIDER. Dividing
+	// by 128 guarantees the SPI buffer will never overflow on the LED
+	// matrix, so at faster speeds we leave a gap after each command for
+	// the matrix to act on it.
+	// Commands below are queued with spi_queue_byte() and sent by the
+	// SPI interrupt handler, so none of these functions wait for the
+	// bytes to go out (unless the SPI queue is full).
+	spi_setup_master(LEDMATRIX_SPI_DIVIDER);
+	spi_set_command_gap(LEDMATRIX_COMMAND_GAP_US);
+	spi_set_command_framing(LEDMATRIX_FRAME_COMMANDS);
+
+	// We don't know what the panels are showing at power on, so clear
+	// them to match our (all black) shadow copies
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		spi_select_device(panel);
+		spi_queue_byte(CMD_CLEAR_SCREEN);
+		spi_end_command();
+	}
+
+	ledmatrix_set_frame_budget(0);
+}
+
+void ledmatrix_set_frame_budget(uint16_t microseconds) {
+	if (microseconds == 0) {
+		microseconds = FRAME_PERIOD_MS * 1000U;
+	}
+	frame_stats.frame_budget_us = microseconds;
+}
+
+uint8_t ledmatrix_spi_divider(void) {
+	return LEDMATRIX_SPI_DIVIDER;
+}
+
+// Get or set pixel x of a row of one of the buffers
+static PaletteIndex get_pixel(const uint8_t* row, uint8_t x) {
+	uint8_t pair = row[x >> 1];
+	return (x & 0x01) ? (pair >> 4) : (pair & 0x0F);
+}
+
+static void set_pixel(uint8_t* row, uint8_t x, PaletteIndex index) {
+	uint8_t* pair = &row[x >> 1];
+	if (x & 0x01) {
+		*pair = (*pair & 0x0F) | (index << 4);
+	} else {
+		*pair = (*pair & 0xF0) | (index & 0x0F);
+	}
+}
+
+static void clear_buffer(uint8_t* buffer, uint16_t bytes) {
+	for (uint16_t i = 0; i < bytes; i++) {
+		buffer[i] = 0;
+	}
+}
+
+void ledmatrix_set_palette_colour(PaletteIndex index, PixelColour colour) {
+	if (index == PALETTE_BLACK || index >= LEDMATRIX_PALETTE_SIZE
+			|| palette[index] == colour) {
+		return;
+	}
+	palette[index] = colour;
+	stale_palette_entries |= (1 << index);
+	frame_changed = 1;
+}
+
+PixelColour ledmatrix_palette_colour(PaletteIndex index) {
+	return palette[index & 0x0F];
+}
+
+void ledmatrix_set_palette_priority(PaletteIndex index,
+		LedMatrixPriority priority) {
+	if (index != PALETTE_BLACK && index < LEDMATRIX_PALETTE_SIZE
+			&& priority < LEDMATRIX_NUM_PRIORITIES) {
+		palette_priority[index] = priority;
+	}
 }
 
 void ledmatrix_update_all(MatrixData data) {
-	(void)spi_send_byte(CMD_UPDATE_ALL);
-	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
-		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
-			(void)spi_send_byte(data[x][y]);
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			set_pixel(draw_layer[y], x, data[x][y]);
 		}
 	}
+	frame_changed = 1;
 }
 
-void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
+void ledmatrix_update_pixel(uint8_t x, uint8_t y, PaletteIndex pixel) {
 	if (x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS) {
 		// Position isn't valid - we ignore the request.
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_PIXEL);
-	(void)spi_send_byte(((y & 0x07) << 4) | (x & 0x0F));
-	(void)spi_send_byte(pixel);
+	if (get_pixel(draw_layer[y], x) != pixel) {
+		set_pixel(draw_layer[y], x, pixel);
+		frame_changed = 1;
+	}
 }
 
 void ledmatrix_update_row(uint8_t y, MatrixRow row) {
@@ -49,11 +230,10 @@ void ledmatrix_update_row(uint8_t y, MatrixRow row) {
 		// y value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_ROW);
-	(void)spi_send_byte(y & 0x07);	// row number
-	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++) {
-		(void)spi_send_byte(row[x]);
+	for (uint8_t i = 0; i < SURFACE_ROW_BYTES; i++) {
+		draw_layer[y][i] = (row[2 * i] & 0x0F) | (row[2 * i + 1] << 4);
 	}
+	frame_changed = 1;
 }
 
 void ledmatrix_update_column(uint8_t x, MatrixColumn col) {
@@ -61,35 +241,629 @@ void ledmatrix_update_column(uint8_t x, MatrixColumn col) {
 		// x value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_COL);
-	(void)spi_send_byte(x & 0x0F); // column number
 	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
-		(void)spi_send_byte(col[y]);
+		set_pixel(draw_layer[y], x, col[y]);
 	}
+	frame_changed = 1;
 }
 
+void ledmatrix_update_column_bits(uint8_t x, uint8_t y, uint8_t bits,
+		PaletteIndex colour) {
+	if (x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS || bits == 0) {
+		return;
+	}
+	// Every pixel in the column lives in the same nibble of its row byte,
+	// so work out the nibble once rather than per pixel
+	uint8_t i = x >> 1;
+	uint8_t keep_mask = (x & 0x01) ? 0x0F : 0xF0;
+	uint8_t value = (x & 0x01) ? (colour << 4) : (colour & 0x0F);
+	for (; bits != 0 && y < MATRIX_NUM_ROWS; bits >>= 1, y++) {
+		if (bits & 0x01) {
+			draw_layer[y][i] = (draw_layer[y][i] & keep_mask) | value;
+		}
+	}
+	frame_changed = 1;
+}
+
+// Move every pixel of a buffer with rows of row_bytes bytes one place left
+// or right. Each byte holds two neighbouring pixels, so this is a 4 bit
+// shift along each row.
+static void shift_buffer_left(uint8_t* buffer, uint8_t row_bytes) {
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++, buffer += row_bytes) {
+		for (uint8_t i = 0; i < row_bytes - 1; i++) {
+			buffer[i] = (buffer[i] >> 4) | (buffer[i + 1] << 4);
+		}
+		buffer[row_bytes - 1] >>= 4;
+	}
+}
+
+static void shift_buffer_right(uint8_t* buffer, uint8_t row_bytes) {
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++, buffer += row_bytes) {
+		for (uint8_t i = row_bytes - 1; i > 0; i--) {
+			buffer[i] = (buffer[i] << 4) | (buffer[i - 1] >> 4);
+		}
+		buffer[0] <<= 4;
+	}
+}
+
+// Move every row of a buffer one place up (towards higher y) or down
+static void shift_buffer_up(uint8_t* buffer, uint8_t row_bytes) {
+	for (uint16_t i = row_bytes * (MATRIX_NUM_ROWS - 1); i > 0; i--) {
+		buffer[i - 1 + row_bytes] = buffer[i - 1];
+	}
+	clear_buffer(buffer, row_bytes);
+}
+
+static void shift_buffer_down(uint8_t* buffer, uint8_t row_bytes) {
+	for (uint16_t i = 0; i < row_bytes * (MATRIX_NUM_ROWS - 1); i++) {
+		buffer[i] = buffer[i + row_bytes];
+	}
+	clear_buffer(buffer + row_bytes * (MATRIX_NUM_ROWS - 1), row_bytes);
+}
+
+// The shift commands move what a panel is showing, so we shift our shadow
+// copy to match. The row or column shifted in is blank on the panel.
+// These send the command to every panel.
+static void send_shift(uint8_t direction) {
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		spi_select_device(panel);
+		spi_queue_byte(CMD_SHIFT_DISPLAY);
+		spi_queue_byte(direction);
+		spi_end_command();
+		shift_us += SHIFT_COMMAND_US;
+	}
+}
+
+static void shift_panels_left(void) {
+	send_shift(0x02);
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		shift_buffer_left(shadow[panel][0], PANEL_ROW_BYTES);
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			resend_pixels[panel][y] >>= 1;
+		}
+	}
+}
+
+static void shift_panels_right(void) {
+	send_shift(0x01);
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		shift_buffer_right(shadow[panel][0], PANEL_ROW_BYTES);
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			resend_pixels[panel][y] <<= 1;
+		}
+	}
+}
+
+// The display shifts also shift the layers, so that anything not yet
+// flushed moves with the rest of the picture
 void ledmatrix_shift_display_left(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x02);
+	shift_panels_left();
+	for (uint8_t layer = 0; layer < LEDMATRIX_NUM_LAYERS; layer++) {
+		shift_buffer_left(layers[layer][0], SURFACE_ROW_BYTES);
+	}
+	frame_changed = 1;
 }
 
 void ledmatrix_shift_display_right(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x01);
+	shift_panels_right();
+	for (uint8_t layer = 0; layer < LEDMATRIX_NUM_LAYERS; layer++) {
+		shift_buffer_right(layers[layer][0], SURFACE_ROW_BYTES);
+	}
+	frame_changed = 1;
 }
 
 void ledmatrix_shift_display_up(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x08);
+	send_shift(0x08);
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		shift_buffer_up(shadow[panel][0], PANEL_ROW_BYTES);
+		for (uint8_t y = MATRIX_NUM_ROWS - 1; y > 0; y--) {
+			resend_pixels[panel][y] = resend_pixels[panel][y - 1];
+		}
+		resend_pixels[panel][0] = 0;
+	}
+	for (uint8_t layer = 0; layer < LEDMATRIX_NUM_LAYERS; layer++) {
+		shift_buffer_up(layers[layer][0], SURFACE_ROW_BYTES);
+	}
 }
 
 void ledmatrix_shift_display_down(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x04);
+	send_shift(0x04);
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		shift_buffer_down(shadow[panel][0], PANEL_ROW_BYTES);
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS - 1; y++) {
+			resend_pixels[panel][y] = resend_pixels[panel][y + 1];
+		}
+		resend_pixels[panel][MATRIX_NUM_ROWS - 1] = 0;
+	}
+	for (uint8_t layer = 0; layer < LEDMATRIX_NUM_LAYERS; layer++) {
+		shift_buffer_down(layers[layer][0], SURFACE_ROW_BYTES);
+	}
+}
+
+void ledmatrix_set_viewport(uint8_t x) {
+	if (x > MATRIX_NUM_COLUMNS - LEDMATRIX_VIEW_COLUMNS) {
+		x = MATRIX_NUM_COLUMNS - LEDMATRIX_VIEW_COLUMNS;
+	}
+	// Shifting each panel along with the viewport leaves only the columns
+	// shifted in to send. That pays off unless the viewport has moved so
+	// far that sending each panel whole is cheaper.
+	uint8_t distance = (x > viewport_x) ? x - viewport_x : viewport_x - x;
+	if ((uint32_t)distance * (SHIFT_COMMAND_US + COLUMN_COMMAND_US)
+			< ALL_COMMAND_US) {
+		for (uint8_t i = 0; i < distance; i++) {
+			if (x > viewport_x) {
+				shift_panels_left();
+			} else {
+				shift_panels_right();
+			}
+		}
+	}
+	if (x != viewport_x) {
+		viewport_x = x;
+		frame_changed = 1;
+	}
+}
+
+uint8_t ledmatrix_viewport(void) {
+	return viewport_x;
 }
 
 void ledmatrix_clear(void) {
-	(void)spi_send_byte(CMD_CLEAR_SCREEN);
+	clear_buffer(draw_layer[0], sizeof(SurfaceFrame));
+	frame_changed = 1;
+}
+
+PaletteIndex ledmatrix_get_pixel(uint8_t x, uint8_t y) {
+	if (x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS) {
+		return PALETTE_BLACK;
+	}
+	return get_pixel(draw_layer[y], x);
+}
+
+LedMatrixLayer ledmatrix_draw_to(LedMatrixLayer layer) {
+	LedMatrixLayer previous = draw_layer_number;
+	if (layer < LEDMATRIX_NUM_LAYERS) {
+		draw_layer_number = layer;
+		draw_layer = layers[layer];
+	}
+	return previous;
+}
+
+// Lay the part of the layers each panel shows over each other, from the
+// bottom layer up, into composed. Index 0 pixels in the upper layers are
+// transparent. When the panel starts at an odd surface column each pair of
+// pixels straddles two bytes of the layers.
+static void compose_layers(void) {
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		uint8_t first_x = viewport_x + panel * LEDMATRIX_PANEL_COLUMNS;
+		uint8_t first_byte = first_x >> 1;
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			for (uint8_t i = 0; i < PANEL_ROW_BYTES; i++) {
+				uint8_t pair = 0;
+				for (uint8_t layer = 0; layer < LEDMATRIX_NUM_LAYERS;
+						layer++) {
+					const uint8_t* row = &layers[layer][y][first_byte + i];
+					uint8_t over = (first_x & 0x01) ?
+							(row[0] >> 4) | (row[1] << 4) : row[0];
+					if (layer == 0) {
+						pair = over;
+						continue;
+					}
+					if (over & 0x0F) {
+						pair = (pair & 0xF0) | (over & 0x0F);
+					}
+					if (over & 0xF0) {
+						pair = (pair & 0x0F) | (over & 0xF0);
+					}
+				}
+				composed[panel][y][i] = pair;
+			}
+		}
+	}
+}
+
+// Mark every pixel showing a palette entry that has changed colour to be
+// resent
+static void mark_stale_pixels(void) {
+	if (stale_palette_entries == 0) {
+		return;
+	}
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+				if (stale_palette_entries
+						& (1 << get_pixel(shadow[panel][y], x))) {
+					resend_pixels[panel][y] |= (1 << x);
+				}
+			}
+		}
+	}
+	stale_palette_entries = 0;
+}
+
+// Returns 1 if pixel (x, y) of a panel needs to be sent - i.e. it has
+// changed, or the colour of its palette entry has changed.
+static uint8_t pixel_needs_sending(uint8_t panel, uint8_t x, uint8_t y) {
+	return get_pixel(composed[panel][y], x) != get_pixel(shadow[panel][y], x)
+			|| (resend_pixels[panel][y] & (1 << x));
+}
+
+static void clear_resend_pixels(uint8_t panel) {
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		resend_pixels[panel][y] = 0;
+	}
+}
+
+// Send a single command to a panel and bring our shadow copy of the panel
+// up to date with it
+static void send_clear(uint8_t panel) {
+	spi_select_device(panel);
+	spi_queue_byte(CMD_CLEAR_SCREEN);
+	spi_end_command();
+	clear_buffer(shadow[panel][0], sizeof(PanelFrame));
+	clear_resend_pixels(panel);
+}
+
+static void send_all(uint8_t panel) {
+	spi_select_device(panel);
+	spi_queue_byte(CMD_UPDATE_ALL);
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		for (uint8_t i = 0; i < PANEL_ROW_BYTES; i++) {
+			uint8_t pair = composed[panel][y][i];
+			spi_queue_byte(palette[pair & 0x0F]);
+			spi_queue_byte(palette[pair >> 4]);
+			shadow[panel][y][i] = pair;
+		}
+	}
+	spi_end_command();
+	clear_resend_pixels(panel);
+}
+
+static void send_pixel(uint8_t panel, uint8_t x, uint8_t y) {
+	PaletteIndex index = get_pixel(composed[panel][y], x);
+	spi_select_device(panel);
+	spi_queue_byte(CMD_UPDATE_PIXEL);
+	spi_queue_byte(((y & 0x07) << 4) | (x & 0x0F));
+	spi_queue_byte(palette[index]);
+	spi_end_command();
+	set_pixel(shadow[panel][y], x, index);
+	resend_pixels[panel][y] &= ~(1 << x);
+}
+
+static void send_row(uint8_t panel, uint8_t y) {
+	spi_select_device(panel);
+	spi_queue_byte(CMD_UPDATE_ROW);
+	spi_queue_byte(y & 0x07);	// row number
+	for (uint8_t i = 0; i < PANEL_ROW_BYTES; i++) {
+		uint8_t pair = composed[panel][y][i];
+		spi_queue_byte(palette[pair & 0x0F]);
+		spi_queue_byte(palette[pair >> 4]);
+		shadow[panel][y][i] = pair;
+	}
+	spi_end_command();
+	resend_pixels[panel][y] = 0;
+}
+
+// Resend row y of a panel as our shadow copy says the panel is showing it.
+// (The shadow copy is always up to date, even just after a shift when the
+// composed layers are not.)
+static void resend_row(uint8_t panel, uint8_t y) {
+	spi_select_device(panel);
+	spi_queue_byte(CMD_UPDATE_ROW);
+	spi_queue_byte(y & 0x07);	// row number
+	for (uint8_t i = 0; i < PANEL_ROW_BYTES; i++) {
+		uint8_t pair = shadow[panel][y][i];
+		spi_queue_byte(palette[pair & 0x0F]);
+		spi_queue_byte(palette[pair >> 4]);
+	}
+	spi_end_command();
+	resend_pixels[panel][y] = 0;
+}
+
+static void send_column(uint8_t panel, uint8_t x) {
+	spi_select_device(panel);
+	spi_queue_byte(CMD_UPDATE_COL);
+	spi_queue_byte(x & 0x0F); // column number
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		PaletteIndex index = get_pixel(composed[panel][y], x);
+		spi_queue_byte(palette[index]);
+		set_pixel(shadow[panel][y], x, index);
+		resend_pixels[panel][y] &= ~(1 << x);
+	}
+	spi_end_command();
+}
+
+// The priority of sending pixel (x, y) of a panel: the more important of
+// the colour it is showing and the colour it is changing to, so that
+// erasing the ball is as urgent as drawing it. (Lower numbers are more
+// important.)
+static uint8_t pixel_priority(uint8_t panel, uint8_t x, uint8_t y) {
+	uint8_t shown = palette_priority[get_pixel(shadow[panel][y], x)];
+	uint8_t wanted = palette_priority[get_pixel(composed[panel][y], x)];
+	return (shown < wanted) ? shown : wanted;
+}
+
+// The priority of the most important pixel that needs sending in a column
+// or row of a panel (LEDMATRIX_NUM_PRIORITIES if none do)
+static uint8_t column_priority(uint8_t panel, uint8_t x) {
+	uint8_t priority = LEDMATRIX_NUM_PRIORITIES;
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		if (pixel_needs_sending(panel, x, y)
+				&& pixel_priority(panel, x, y) < priority) {
+			priority = pixel_priority(panel, x, y);
+		}
+	}
+	return priority;
+}
+
+static uint8_t row_priority(uint8_t panel, uint8_t y) {
+	uint8_t priority = LEDMATRIX_NUM_PRIORITIES;
+	for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+		if (pixel_needs_sending(panel, x, y)
+				&& pixel_priority(panel, x, y) < priority) {
+			priority = pixel_priority(panel, x, y);
+		}
+	}
+	return priority;
+}
+
+// Returns 1 if a command of command_bytes bytes, taking command_us on the
+// link, can be sent after sent_us of a flush with the given budget: it must
+// fit in what is left of the budget (except that the first command always
+// does, so the display can't get stuck), and in the SPI queue, so that
+// queueing it doesn't hold up the caller.
+static uint8_t command_fits(uint16_t sent_us, uint16_t budget,
+		uint16_t command_us, uint8_t command_bytes) {
+	return (sent_us == 0 || sent_us + command_us <= budget)
+			&& spi_queue_space() >= command_bytes;
+}
+
+// Send the pixels that need sending, as column, row or single pixel
+// commands (whichever is quickest for each). Commands are sent in priority
+// order, across all the panels. Once a command doesn't fit (see
+// command_fits()) it, and every command after it, is left for the next
+// flush. Returns the time the commands take to send, in microseconds.
+static uint16_t send_changes(uint16_t budget) {
+	// Plan the commands. Columns with enough changes are sent whole, then
+	// rows with enough changes left over, then single pixels.
+	uint16_t whole_columns[LEDMATRIX_NUM_PANELS];
+	uint8_t whole_rows[LEDMATRIX_NUM_PANELS];
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		whole_columns[panel] = 0;
+		whole_rows[panel] = 0;
+		for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+			uint8_t changes = 0;
+			for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+				if (pixel_needs_sending(panel, x, y)) {
+					changes++;
+				}
+			}
+			if (changes * PIXEL_COMMAND_US > COLUMN_COMMAND_US) {
+				whole_columns[panel] |= (1 << x);
+			}
+		}
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			uint8_t changes = 0;
+			for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+				if (!(whole_columns[panel] & (1 << x))
+						&& pixel_needs_sending(panel, x, y)) {
+					changes++;
+				}
+			}
+			if (changes * PIXEL_COMMAND_US > ROW_COMMAND_US) {
+				whole_rows[panel] |= (1 << y);
+			}
+		}
+	}
+
+	uint16_t sent_us = 0;
+	for (uint8_t priority = 0; priority < LEDMATRIX_NUM_PRIORITIES;
+			priority++) {
+		for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+			for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+				if (!(whole_columns[panel] & (1 << x))
+						|| column_priority(panel, x) != priority) {
+					continue;
+				}
+				if (!command_fits(sent_us, budget, COLUMN_COMMAND_US,
+						COLUMN_COMMAND_BYTES)) {
+					goto out_of_budget;
+				}
+				send_column(panel, x);
+				sent_us += COLUMN_COMMAND_US;
+			}
+			for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+				if (!(whole_rows[panel] & (1 << y))
+						|| row_priority(panel, y) != priority) {
+					continue;
+				}
+				if (!command_fits(sent_us, budget, ROW_COMMAND_US,
+						ROW_COMMAND_BYTES)) {
+					goto out_of_budget;
+				}
+				send_row(panel, y);
+				sent_us += ROW_COMMAND_US;
+			}
+			for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+				if (whole_rows[panel] & (1 << y)) {
+					continue;
+				}
+				for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+					if ((whole_columns[panel] & (1 << x))
+							|| !pixel_needs_sending(panel, x, y)
+							|| pixel_priority(panel, x, y) != priority) {
+						continue;
+					}
+					if (!command_fits(sent_us, budget, PIXEL_COMMAND_US,
+							PIXEL_COMMAND_BYTES)) {
+						goto out_of_budget;
+					}
+					send_pixel(panel, x, y);
+					sent_us += PIXEL_COMMAND_US;
+				}
+			}
+		}
+	}
+	return sent_us;
+
+out_of_budget:
+	// Make sure the next flush picks up where we left off
+	frame_changed = 1;
+	flush_deferred = 1;
+	return sent_us;
+}
+
+// Estimate the time taken to send the given number of changed pixels in
+// each column of a panel: each column is sent either pixel by pixel or as
+// a whole column, whichever is quicker. (Rows are ignored here - they only
+// pay off when a row has nearly every pixel changed, which is also when a
+// whole update becomes the better choice.) The number of SPI bytes that
+// takes is put in bytes.
+static uint16_t estimate_cost(
+		uint8_t changes_in_column[LEDMATRIX_PANEL_COLUMNS], uint16_t* bytes) {
+	uint16_t cost = 0;
+	*bytes = 0;
+	for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+		uint16_t pixel_cost = changes_in_column[x] * PIXEL_COMMAND_US;
+		if (pixel_cost < COLUMN_COMMAND_US) {
+			cost += pixel_cost;
+			*bytes += changes_in_column[x] * PIXEL_COMMAND_BYTES;
+		} else {
+			cost += COLUMN_COMMAND_US;
+			*bytes += COLUMN_COMMAND_BYTES;
+		}
+	}
+	return cost;
+}
+
+uint16_t ledmatrix_flush(void) {
+	if (!frame_changed) {
+		return 0;
+	}
+	frame_changed = 0;
+	compose_layers();
+	mark_stale_pixels();
+
+	uint16_t budget = (shift_us < frame_stats.frame_budget_us) ?
+			frame_stats.frame_budget_us - shift_us : 0;
+	uint16_t sent_us = 0;
+	uint8_t any_changes = 0;
+	for (uint8_t panel = 0; panel < LEDMATRIX_NUM_PANELS; panel++) {
+		// Count the pixels that need sending in each column. We also count
+		// the lit (non zero index) pixels in each column, which are the
+		// pixels we would have to send after a clear screen command.
+		uint8_t changes_in_column[LEDMATRIX_PANEL_COLUMNS];
+		uint8_t lit_in_column[LEDMATRIX_PANEL_COLUMNS];
+		uint8_t total_changes = 0;
+		for (uint8_t x = 0; x < LEDMATRIX_PANEL_COLUMNS; x++) {
+			changes_in_column[x] = 0;
+			lit_in_column[x] = 0;
+			for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+				if (pixel_needs_sending(panel, x, y)) {
+					changes_in_column[x]++;
+				}
+				if (get_pixel(composed[panel][y], x) != PALETTE_BLACK) {
+					lit_in_column[x]++;
+				}
+			}
+			total_changes += changes_in_column[x];
+		}
+		if (total_changes == 0) {
+			continue;
+		}
+		any_changes = 1;
+
+		// Choose between sending the changes, clearing the panel and then
+		// sending the lit pixels, or sending the whole panel. Clearing or
+		// sending the whole panel can't be spread over several frames, so
+		// they are only chosen when they fit in what is left of this
+		// frame's budget - and a clear only when the lit pixels fit in the
+		// SPI queue as well, so the panel isn't left blank while they wait.
+		// An update all command is longer than the SPI queue, so sending
+		// one holds us up until the queue has room for all of it. It is
+		// only chosen when nearly every pixel has changed, which happens
+		// when the display is redrawn between games rather than in play,
+		// and then the new picture appears at once rather than over
+		// several frames. The changes are sent below, for all the panels
+		// together.
+		uint16_t budget_left = budget - sent_us;
+		uint16_t change_bytes;
+		uint16_t clear_bytes;
+		uint16_t change_cost = estimate_cost(changes_in_column, &change_bytes);
+		uint16_t clear_cost = CLEAR_COMMAND_US
+				+ estimate_cost(lit_in_column, &clear_bytes);
+		if (USE_UPDATE_ALL && change_cost >= ALL_COMMAND_US
+				&& clear_cost >= ALL_COMMAND_US
+				&& ALL_COMMAND_US <= budget_left) {
+			send_all(panel);
+			sent_us += ALL_COMMAND_US;
+		} else if (clear_cost < change_cost && clear_cost <= budget_left
+				&& CLEAR_COMMAND_BYTES + clear_bytes <= spi_queue_space()) {
+			// After the clear only the lit pixels need sending
+			send_clear(panel);
+			sent_us += CLEAR_COMMAND_US;
+		}
+	}
+	if (!any_changes) {
+		return 0;
+	}
+	return sent_us + send_changes(budget - sent_us);
+}
+
+uint16_t ledmatrix_commit_frame(void) {
+	uint16_t frame_us = shift_us + ledmatrix_flush();
+	shift_us = 0;
+
+#if LEDMATRIX_SCRUB_INTERVAL_FRAMES
+	// Nothing tells us if a byte to a panel is lost or corrupted, so we
+	// slowly repaint every panel in the background, a row at a time. A row
+	// is only resent in a frame that had no changes to defer and stays
+	// under half its SPI time budget with the row (and its command gap)
+	// included, and only if the SPI queue has room for it, so the scrub
+	// never adds to a busy frame. (A row update is used because it covers
+	// a panel in the fewest commands.)
+	if (frames_since_scrub < LEDMATRIX_SCRUB_INTERVAL_FRAMES) {
+		frames_since_scrub++;
+	}
+	if (frames_since_scrub >= LEDMATRIX_SCRUB_INTERVAL_FRAMES
+			&& !flush_deferred
+			&& frame_us + ROW_COMMAND_US <= frame_stats.frame_budget_us / 2
+			&& spi_queue_space() >= ROW_COMMAND_BYTES) {
+		resend_row(scrub_panel, scrub_row);
+		if (++scrub_row == MATRIX_NUM_ROWS) {
+			scrub_row = 0;
+			scrub_panel = (scrub_panel + 1) % LEDMATRIX_NUM_PANELS;
+		}
+		frames_since_scrub = 0;
+		frame_us += ROW_COMMAND_US;
+	}
+#endif
+
+	if (flush_deferred) {
+		frame_stats.frames_deferred++;
+		flush_deferred = 0;
+	}
+	frame_stats.last_frame_us = frame_us;
+	if (frame_us > frame_stats.max_frame_us) {
+		frame_stats.max_frame_us = frame_us;
+	}
+	if (frame_us > frame_stats.frame_budget_us) {
+		frame_stats.frames_over_budget++;
+	}
+	frame_stats.frames++;
+	return frame_us;
+}
+
+void ledmatrix_get_frame_stats(LedMatrixFrameStats* stats) {
+	*stats = frame_stats;
+}
+
+void ledmatrix_reset_frame_stats(void) {
+	frame_stats.last_frame_us = 0;
+	frame_stats.max_frame_us = 0;
+	frame_stats.frames = 0;
+	frame_stats.frames_over_budget = 0;
+	frame_stats.frames_deferred = 0;
 }
 
 void copy_matrix_column(MatrixColumn from, MatrixColumn to) {
@@ -105,14 +879,14 @@ void copy_matrix_row(MatrixRow from, MatrixRow to) {
 }
 
 void set_matrix_column_to_colour(MatrixColumn matrix_column,
-		PixelColour colour) {
+		PaletteIndex colour) {
 
 	for (uint8_t row = 0; row < MATRIX_NUM_ROWS; row++) {
 		matrix_column[row] = colour;
 	}
 }
 
-void set_matrix_row_to_colour(MatrixRow matrix_row, PixelColour colour) {
+void set_matrix_row_to_colour(MatrixRow matrix_row, PaletteIndex colour) {
 	for (uint8_t column = 0; column < MATRIX_NUM_COLUMNS; column++) {
 		matrix_row[column] = colour;
 	}
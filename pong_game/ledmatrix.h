@@ -10,40 +10,204 @@
 #include <stdint.h>
 #include "pixel_colour.h"
 
-// The matrix has 16 columns (x ranges from 0 to 15, left to right) and
-// 8 rows (y ranges from 0 to 7, bottom to top) - as per the X,Y
-// coordinates marked on the board.
-#define MATRIX_NUM_COLUMNS 16
+// The display is a surface of MATRIX_NUM_COLUMNS columns (x ranges from 0
+// to MATRIX_NUM_COLUMNS - 1, left to right) and 8 rows (y ranges from 0 to
+// 7, bottom to top) - as per the X,Y coordinates marked on the board.
+//
+// It is shown on a chain of LEDMATRIX_NUM_PANELS matrices side by side,
+// panel 0 on the left. Each panel is a separate SPI device with its own
+// slave select line (the SPI device number is the panel number - see
+// spi.h, whose SPI_NUM_DEVICES must be at least LEDMATRIX_NUM_PANELS).
+// The panels have LEDMATRIX_PANEL_COLUMNS columns each, and together show
+// the LEDMATRIX_VIEW_COLUMNS columns of the surface in the viewport (see
+// ledmatrix_set_viewport()). Unless MATRIX_NUM_COLUMNS is set, the surface
+// is exactly as wide as the panels - with one panel, the 16 x 8 matrix.
+#ifndef LEDMATRIX_NUM_PANELS
+#define LEDMATRIX_NUM_PANELS 1
+#endif
+#define LEDMATRIX_PANEL_COLUMNS 16
+#define LEDMATRIX_VIEW_COLUMNS (LEDMATRIX_PANEL_COLUMNS * LEDMATRIX_NUM_PANELS)
+#ifndef MATRIX_NUM_COLUMNS
+#define MATRIX_NUM_COLUMNS LEDMATRIX_VIEW_COLUMNS
+#endif
 #define MATRIX_NUM_ROWS 8
 
+// SPI statistics for the frames committed by ledmatrix_commit_frame(). The
+// times are how long the frame's commands take on the SPI link (command
+// gaps included), in microseconds. frame_budget_us is the time each frame
+// may use (see ledmatrix_set_frame_budget()). frames_deferred counts the
+// frames that left some changes for a later frame to stay within that
+// budget.
+typedef struct {
+	uint16_t last_frame_us;
+	uint16_t max_frame_us;
+	uint16_t frame_budget_us;
+	uint16_t frames;
+	uint16_t frames_over_budget;
+	uint16_t frames_deferred;
+} LedMatrixFrameStats;
+
+// Pixels are drawn as 4 bit indices into a palette of PixelColours. The
+// colour for each index is looked up as pixels are sent to the matrix, so
+// changing a palette entry recolours every pixel using it without the
+// caller redrawing anything. Index 0 is always black.
+typedef uint8_t PaletteIndex;
+#define LEDMATRIX_PALETTE_SIZE 16
+#define PALETTE_BLACK 0
+
+// How urgently changes to pixels of each palette entry are sent (see
+// ledmatrix_flush()), most urgent first
+typedef enum {
+	LEDMATRIX_PRIORITY_GAMEPLAY,
+	LEDMATRIX_PRIORITY_HUD,
+	LEDMATRIX_PRIORITY_DECORATION,
+	LEDMATRIX_NUM_PRIORITIES
+} LedMatrixPriority;
+
 // Data types which can be used to store display information
-typedef PixelColour MatrixData[MATRIX_NUM_COLUMNS][MATRIX_NUM_ROWS];
-typedef PixelColour MatrixRow[MATRIX_NUM_COLUMNS];
-typedef PixelColour MatrixColumn[MATRIX_NUM_ROWS];
+typedef PaletteIndex MatrixData[MATRIX_NUM_COLUMNS][MATRIX_NUM_ROWS];
+typedef PaletteIndex MatrixRow[MATRIX_NUM_COLUMNS];
+typedef PaletteIndex MatrixColumn[MATRIX_NUM_ROWS];
+
+// The display is made up of layers drawn one over another: the effects
+// layer (short lived decorations such as trails and sparks) at the bottom,
+// then the game layer, with the HUD layer (scores, meters and other
+// overlays) over them. Pixels of index 0 in the upper layers are
+// transparent - the layers below show through them - so removing an
+// overlay uncovers whatever the game has drawn underneath, and effects
+// never hide anything the game draws.
+typedef enum {
+	LEDMATRIX_LAYER_EFFECTS,
+	LEDMATRIX_LAYER_GAME,
+	LEDMATRIX_LAYER_HUD,
+	LEDMATRIX_NUM_LAYERS
+} LedMatrixLayer;
+
+// SPI speed. The SPI clock is divided by LEDMATRIX_SPI_DIVIDER, which is
+// 128 unless set otherwise - slow enough for the matrix to keep up with any
+// command stream. A faster divider (8, 16, 32 or 64) also needs
+// LEDMATRIX_COMMAND_GAP_US: the time (up to 255 microseconds) left after
+// each command for the matrix to act on it. The matrix sends nothing back
+// to show whether it has kept up, so the gap has to be measured on the
+// hardware for the divider chosen (find the shortest gap at which the
+// start screen animation shows without glitches, and add a margin). At
+// these speeds the matrix's update all command isn't used, so it never
+// gets more than a row's bytes without a gap.
+#ifndef LEDMATRIX_SPI_DIVIDER
+#define LEDMATRIX_SPI_DIVIDER 128
+#endif
+#if LEDMATRIX_SPI_DIVIDER < 128 && !defined(LEDMATRIX_COMMAND_GAP_US)
+#error "A fast LEDMATRIX_SPI_DIVIDER needs a measured LEDMATRIX_COMMAND_GAP_US"
+#endif
+#ifndef LEDMATRIX_COMMAND_GAP_US
+#define LEDMATRIX_COMMAND_GAP_US 0
+#endif
+#if LEDMATRIX_COMMAND_GAP_US > 255
+#error "LEDMATRIX_COMMAND_GAP_US must be at most 255"
+#endif
+
+// Keeping the matrix in step. If LEDMATRIX_FRAME_COMMANDS is non-zero each
+// command is framed by the SPI slave select line (see
+// spi_set_command_framing()). Every LEDMATRIX_SCRUB_INTERVAL_FRAMES frames
+// (0 for never) ledmatrix_commit_frame() resends one row of what the matrix
+// should be showing, if the frame has room to spare, so any pixels that
+// were corrupted on the way are corrected within 8 such intervals.
+#ifndef LEDMATRIX_FRAME_COMMANDS
+#define LEDMATRIX_FRAME_COMMANDS 0
+#endif
+#ifndef LEDMATRIX_SCRUB_INTERVAL_FRAMES
+#define LEDMATRIX_SCRUB_INTERVAL_FRAMES 5
+#endif
 
 // Setup SPI communication with the LED matrix.
-// This function must be called before the LED matrix functions
-// below are used.
+// This function must be called (with interrupts disabled) before the LED
+// matrix functions below are used.
 void ledmatrix_setup(void);
 
+// The SPI clock divider (LEDMATRIX_SPI_DIVIDER)
+uint8_t ledmatrix_spi_divider(void);
+
+// Set the colour of a palette entry (1 to LEDMATRIX_PALETTE_SIZE - 1).
+// Every entry other than 0 must be set before it is used. Pixels already
+// drawn with this entry are resent at the next flush.
+void ledmatrix_set_palette_colour(PaletteIndex index, PixelColour colour);
+PixelColour ledmatrix_palette_colour(PaletteIndex index);
+
+// Set the priority of a palette entry (1 to LEDMATRIX_PALETTE_SIZE - 1).
+// Entries are LEDMATRIX_PRIORITY_GAMEPLAY unless set otherwise. A changed
+// pixel is sent at the higher priority of its old and new colours.
+void ledmatrix_set_palette_priority(PaletteIndex index,
+		LedMatrixPriority priority);
+
 // Functions to update the display
 // For those functions which take an x or a y value, the value must be valid
 // or the request will be ignored. (i.e. x must be < MATRIX_NUM_COLUMNS
 // and y must be < MATRIX_NUM_ROWS)
+// These functions (other than the shift functions) only change the layer
+// chosen by ledmatrix_draw_to() - nothing is sent to the matrix until
+// ledmatrix_flush() is called. ledmatrix_clear() clears just that layer.
+// The shift functions send their command to every panel straight away and
+// shift every layer. (Columns that move from one panel to the next are
+// sent at the next flush.)
 void ledmatrix_update_all(MatrixData data);
-void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel);
+void ledmatrix_update_pixel(uint8_t x, uint8_t y, PaletteIndex pixel);
 void ledmatrix_update_row(uint8_t y, MatrixRow row);
 void ledmatrix_update_column(uint8_t x, MatrixColumn col);
+// Draw a column of pixels from a bitmap: pixel (x, y + i) is set to colour
+// for each bit i set in bits (bit 0 is the bottom pixel). Pixels for clear
+// bits are left as they are, as are any that would fall off the top.
+void ledmatrix_update_column_bits(uint8_t x, uint8_t y, uint8_t bits,
+		PaletteIndex colour);
 void ledmatrix_shift_display_left(void);
 void ledmatrix_shift_display_right(void);
 void ledmatrix_shift_display_up(void);
 void ledmatrix_shift_display_down(void);
 void ledmatrix_clear(void);
 
+// Returns pixel (x, y) of the layer chosen by ledmatrix_draw_to() (0 if x
+// or y is not valid)
+PaletteIndex ledmatrix_get_pixel(uint8_t x, uint8_t y);
+
+// Move the viewport so that the panels show columns x to
+// x + LEDMATRIX_VIEW_COLUMNS - 1 of the surface (x is limited so the
+// viewport stays on the surface). The viewport starts at column 0. A move
+// of less than a panel's width shifts each panel with the matrix's shift
+// command, so the next flush only sends the columns that have come into
+// view on each panel rather than redrawing them.
+void ledmatrix_set_viewport(uint8_t x);
+uint8_t ledmatrix_viewport(void);
+
+// Choose the layer the update functions draw to (the game layer to start
+// with). Returns the layer that was being drawn to, so it can be restored.
+LedMatrixLayer ledmatrix_draw_to(LedMatrixLayer layer);
+
+// Send any pixels that differ between the composed layers and what the
+// matrix is showing. Changes are grouped into row, column, whole display or
+// clear screen commands when that takes less time on the SPI link than
+// updating each pixel. Commands are sent in priority order (see
+// LedMatrixPriority), and if a frame's changes don't fit in its budget the
+// less important ones are left for the following frames. Returns the time
+// (in microseconds) the commands queued for the matrix take to send.
+uint16_t ledmatrix_flush(void);
+
+// Commit a frame: flush the layers to the matrix (plus a background scrub
+// row when one is due) and record how long this frame takes on the SPI
+// link (including any shift commands since the last commit). This should
+// be called once per frame tick (see frame_due() in timer0.h) so that each
+// frame goes out as a single burst. Returns the time in microseconds.
+uint16_t ledmatrix_commit_frame(void);
+void ledmatrix_get_frame_stats(LedMatrixFrameStats* stats);
+void ledmatrix_reset_frame_stats(void);
+
+// Set the SPI time in microseconds each frame may use (including shifts).
+// 0 sets it to the frame period, which is the budget ledmatrix_setup()
+// starts with.
+void ledmatrix_set_frame_budget(uint16_t microseconds);
+
 // Functions to operate on MatrixRow and MatrixColumn data structures
 void copy_matrix_column(MatrixColumn from, MatrixColumn to);
 void copy_matrix_row(MatrixRow from, MatrixRow to);
-void set_matrix_column_to_colour(MatrixColumn matrix_column, PixelColour colour);
-void set_matrix_row_to_colour(MatrixRow matrix_row, PixelColour colour);
+void set_matrix_column_to_colour(MatrixColumn matrix_column, PaletteIndex colour);
+void set_matrix_row_to_colour(MatrixRow matrix_row, PaletteIndex colour);
 
 #endif /* LEDMATRIX_H_ */
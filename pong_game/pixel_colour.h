@@ -26,4 +26,16 @@ typedef uint8_t PixelColour;
 // Score Colour
 #define COLOUR_SCORE		(0x8F)
 
+// Ball Colour at a quarter, half and three quarters of full brightness,
+// for drawing the ball part way between squares
+#define COLOUR_BALL_SHADE_1	(0x03)
+#define COLOUR_BALL_SHADE_2	(0x07)
+#define COLOUR_BALL_SHADE_3	(0x0B)
+
+// Effect Colours, from faintest to brightest (see effects.h)
+#define COLOUR_EFFECT_SHADE_1	(0x02)
+#define COLOUR_EFFECT_SHADE_2	(0x14)
+#define COLOUR_EFFECT_SHADE_3	(0x28)
+#define COLOUR_EFFECT_SHADE_4	(0x3C)
+
 #endif /* PIXEL_COLOUR_H_ */
@@ -9,20 +9,34 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 
-#define F_CPU 8000000UL
 #include <util/delay.h>
 
 #include "game.h"
 #include "display.h"
 #include "ledmatrix.h"
+#include "spi.h"
 #include "buttons.h"
 #include "serialio.h"
 #include "terminalio.h"
+#include "terminal_screen.h"
+#include "terminal_board.h"
+#include "console.h"
+#include "telemetry.h"
 #include "timer0.h"
+#include "animation.h"
+#include "text_scroll.h"
+#include "effects.h"
+
+// Serial terminal baud rate - up to 1000000 with an 8MHz clock (see
+// init_serial_stdio()). The terminal must be set to match.
+#ifndef SERIAL_BAUD_RATE
+#define SERIAL_BAUD_RATE 19200
+#endif
 
 
 // Function prototypes - these are defined below (after main()) in the order
@@ -32,6 +46,24 @@ void start_screen(void);
 void new_game(void);
 void play_game(void);
 void handle_game_over(void);
+void report_stats(void);
+
+// Terminal fields for the values that change during a game (see
+// terminal_screen.h)
+static TermField score_fields[2];
+static TermField speed_field;
+static TermField paused_field;
+static TermField console_field;
+#ifdef DEBUG
+// The LED matrix SPI stats: last, max and budget time per frame (in
+// microseconds) and the number of frames over budget
+#define NUM_FRAME_STATS 4
+static const uint8_t FRAME_STATS_X[NUM_FRAME_STATS] = {32, 42, 55, 66};
+static TermField frame_stats_fields[NUM_FRAME_STATS];
+#endif
+
+// Set by the console's reset command to end the game without a game over
+static uint8_t game_reset;
 
 /////////////////////////////// main //////////////////////////////////
 int main(void) {
@@ -47,16 +79,22 @@ int main(void) {
 	while(1) {
 		new_game();
 		play_game();
-		handle_game_over();
+		if (!game_reset) {
+			handle_game_over();
+		}
 	}
 }
 
 void initialise_hardware(void) {
 	ledmatrix_setup();
+	initialise_palette();
 	init_button_interrupts();
-	// Setup serial port for 19200 baud communication with no echo
-	// of incoming characters
-	init_serial_stdio(19200, 0);
+	// Setup serial port for SERIAL_BAUD_RATE communication with no echo
+	// of incoming characters, or 19200 baud if the clock can't make that
+	// rate closely enough
+	if (!init_serial_stdio(SERIAL_BAUD_RATE, 0)) {
+		init_serial_stdio(19200, 0);
+	}
 	
 	init_timer0();
 	// SSD
@@ -68,21 +106,18 @@ void initialise_hardware(void) {
 
 void start_screen(void) {
 	// Clear terminal screen and output a message
-	clear_terminal();
+	term_screen_clear();
 	show_cursor();
 	move_terminal_cursor(10,10);
-	printf_P(PSTR("PONG"));
+	serial_put_string_P(PSTR("PONG"));
 	move_terminal_cursor(10,12);
-	printf_P(PSTR("CSSE2010/7201 A2 by Benjamin Burn - 45507087"));
+	serial_put_string_P(PSTR("CSSE2010/7201 A2 by Benjamin Burn - 45507087"));
 	
 	// Output the static start screen and wait for a push button 
 	// to be pushed or a serial input of 's'
 	show_start_screen();
 
-	uint32_t last_screen_update, current_time;
-	last_screen_update = get_current_time();
-	
-	uint8_t frame_number = 0;
+	uint32_t current_time;
 
 	// Wait until a button is pressed, or 's' is pressed on the terminal
 	while(1) {
@@ -105,17 +140,21 @@ void start_screen(void) {
 		}
 
 		current_time = get_current_time();
-		if (current_time - last_screen_update > 500) {
-			update_start_screen(frame_number);
-			frame_number = (frame_number + 1) % 12;
-			last_screen_update = current_time;
+		animation_update(current_time);
+		if (!animation_running()) {
+			update_start_screen(current_time);
+		}
+
+		// Commit any display changes to the LED matrix once per frame
+		if (frame_due()) {
+			ledmatrix_commit_frame();
 		}
 	}
 }
 
 void new_game(void) {
 	// Clear the serial terminal
-	clear_terminal();
+	term_screen_clear();
 	
 	// Initialise the game and display
 	initialise_game();
@@ -124,6 +163,8 @@ void new_game(void) {
 	// (The cast to void means the return value is ignored.)
 	(void)button_pushed();
 	clear_serial_input_buffer();
+	console_init();
+	game_reset = 0;
 }
 
 
@@ -151,15 +192,39 @@ void play_game(void) {
 	int8_t new_p1score;
 	int8_t new_p2score;
 	int8_t break_lms_flag = 0;
+	ConsoleCommand command;
+	uint16_t argument;
+#ifdef DEBUG
+	uint32_t last_frame_report_time = 0;
+	ledmatrix_reset_frame_stats();
+#endif
 	
 	last_ball_move_time = get_current_time();
-	// Scoring Set-up
+	// Scoring Set-up. The labels never change so they are printed once -
+	// the values are terminal fields, which only send what has changed.
 	move_terminal_cursor(10,10);
-	printf_P(PSTR("Player 1 Score: 0"));
+	serial_put_string_P(PSTR("Player 1 Score: "));
 	move_terminal_cursor(50,10);
-	printf_P(PSTR("Player 2 Score: 0"));
+	serial_put_string_P(PSTR("Player 2 Score: "));
 	move_terminal_cursor(30,5);
-	printf_P(PSTR("Game Speed: 500"));
+	serial_put_string_P(PSTR("Game Speed: "));
+	score_fields[PLAYER_1] = term_screen_add_field(26, 10, 2);
+	score_fields[PLAYER_2] = term_screen_add_field(66, 10, 2);
+	speed_field = term_screen_add_field(42, 5, 4);
+	paused_field = term_screen_add_field(32, 50, 11);
+	console_field = term_screen_add_field(10, 20, 20);
+	term_screen_set_uint(score_fields[PLAYER_1], old_p1score);
+	term_screen_set_uint(score_fields[PLAYER_2], old_p2score);
+	term_screen_set_uint(speed_field, game_speed);
+#ifdef DEBUG
+	move_terminal_cursor(10,18);
+	serial_put_string_P(PSTR("SPI time (us):   last       max       "
+			"budget       over"));
+	for (uint8_t i = 0; i < NUM_FRAME_STATS; i++) {
+		frame_stats_fields[i] = term_screen_add_field(FRAME_STATS_X[i], 18, 5);
+	}
+#endif
+	term_board_init();
 	
 	// testing
 	/*
@@ -171,7 +236,7 @@ void play_game(void) {
 	printf_P(PSTR("led_matrix_score_duration"));*/
 
 	// We play the game until it's over
-	while (!is_game_over()) {
+	while (!is_game_over() && !game_reset) {
 		// Checks if a button has been pushed. If so, creates a flag that a button is being held. 
 		// If flag is 1 paddle moves in given direction while holding button.
 		// If btn_released = btn_pushed() then paddle stops moving.
@@ -193,6 +258,8 @@ void play_game(void) {
 			old_p1score = new_p1score;
 			old_p2score = new_p2score;
 			break_lms_flag = 1;
+			term_screen_set_uint(score_fields[PLAYER_1], new_p1score);
+			term_screen_set_uint(score_fields[PLAYER_2], new_p2score);
 		//}
 		
 		//if (break_lms_flag == 1) {
@@ -288,53 +355,89 @@ void play_game(void) {
 				last_button_time = get_current_time();
 			}
 			
-			// Check Serial Inputs
-			if (serial_input_available()) {
-				char serial_input = fgetc(stdin);
-				if ((serial_input == 'w') | (serial_input == 'W')) {
+			// Check Serial Inputs. The console reads only a few characters
+			// each time round, so typing never holds up the ball.
+			command = console_poll(&argument);
+			switch (command) {
+				case CONSOLE_PADDLE_1_UP:
 					move_player_paddle(PLAYER_1, UP);
-				}
-				if ((serial_input == 's') | (serial_input == 'S') | (serial_input == 'd') | (serial_input == 'D')) {
+					break;
+				case CONSOLE_PADDLE_1_DOWN:
 					move_player_paddle(PLAYER_1, DOWN);
-				}
-				if ((serial_input == 'o') | (serial_input == 'o')) {
+					break;
+				case CONSOLE_PADDLE_2_UP:
 					move_player_paddle(PLAYER_2, UP);
-				}
-				if ((serial_input == 'k') | (serial_input == 'K') | (serial_input == 'l') | (serial_input == 'L')) {
+					break;
+				case CONSOLE_PADDLE_2_DOWN:
 					move_player_paddle(PLAYER_2, DOWN);
-				}
-				if (serial_input == '1') {
-					game_speed = 500;
-					move_terminal_cursor(42,5);
-					printf_P(PSTR("%d"), game_speed);
-				}
-				if (serial_input == '2') {
-					game_speed = 300;
-					move_terminal_cursor(42,5);
-					printf_P(PSTR("%d"), game_speed);
-				}
-				if (serial_input == '3') {
-					game_speed = 200;
-					move_terminal_cursor(42,5);
-					printf_P(PSTR("%d"), game_speed);
-				}
-				if (serial_input == '4') {
-					game_speed = 125;
-					move_terminal_cursor(42,5);
-					printf_P(PSTR("%d"), game_speed);
-				}
-				if ((serial_input == 'p') | (serial_input == 'P')) {
+					break;
+				case CONSOLE_SPEED:
+					game_speed = argument;
+					term_screen_set_uint(speed_field, game_speed);
+					break;
+				case CONSOLE_PAUSE:
 					saved_time = current_time;
-					move_terminal_cursor(32,50);
-					printf_P(PSTR("Game Paused"));
+					term_screen_set_text_P(paused_field, PSTR("Game Paused"));
 					PORTD ^= (1<<3);
 					pause_game();
 					PORTD ^= (1<<3);
 					last_ball_move_time += (get_current_time() - saved_time);
-				}
-			
-			} // if - serial input
+					break;
+				case CONSOLE_SEED:
+					srand(argument);
+					break;
+				case CONSOLE_STATS:
+					report_stats();
+#ifdef DEBUG
+					last_frame_report_time = 0;
+#endif
+					break;
+				case CONSOLE_RESET:
+					game_reset = 1;
+					break;
+				case CONSOLE_TELEMETRY:
+					telemetry_enable(argument);
+					break;
+				default:
+					break;
+			}
+			// Complain about a bad command line until the next command
+			if (command == CONSOLE_INVALID) {
+				term_screen_set_text_P(console_field, PSTR("Unknown command"));
+			} else if (command != CONSOLE_NONE) {
+				term_screen_set_text_P(console_field, PSTR(""));
+			}
 		} //if led_flag == 0
+		
+#ifdef DEBUG
+		// Report the LED matrix SPI time per frame once a second
+		if (get_current_time() - last_frame_report_time >= 1000) {
+			LedMatrixFrameStats frame_stats;
+			ledmatrix_get_frame_stats(&frame_stats);
+			term_screen_set_uint(frame_stats_fields[0],
+					frame_stats.last_frame_us);
+			term_screen_set_uint(frame_stats_fields[1],
+					frame_stats.max_frame_us);
+			term_screen_set_uint(frame_stats_fields[2],
+					frame_stats.frame_budget_us);
+			term_screen_set_uint(frame_stats_fields[3],
+					frame_stats.frames_over_budget);
+			last_frame_report_time = get_current_time();
+		}
+#endif
+		// Commit the display changes made since the last frame tick, so
+		// the matrix only ever sees complete frames. The effects and the
+		// ball are redrawn for each frame so they move smoothly. The
+		// terminal changes go out once per frame too.
+		if (frame_due()) {
+			effects_update();
+			update_ball_motion(get_current_time() - last_ball_move_time,
+					game_speed);
+			ledmatrix_commit_frame();
+			term_screen_update();
+			term_board_update();
+			telemetry_update(get_current_time());
+		}
 		is_game_over();
 	}// main while loop
 	// We get here if the game is over.
@@ -342,14 +445,29 @@ void play_game(void) {
 
 void handle_game_over() {
 	move_terminal_cursor(10,14);
-	printf_P(PSTR("GAME OVER"));
+	serial_put_string_P(PSTR("GAME OVER"));
 	move_terminal_cursor(10,15);
-	printf_P(PSTR("Press a button or 's'/'S' to start a new game"));
+	serial_put_string_P(PSTR("Press a button or 's'/'S' to start a new game"));
 	
 	// Do nothing until a button is pushed. Hint: 's'/'S' should also start a
-	// new game
+	// new game. Meanwhile announce the winner on the LED matrix and then
+	// show the final score.
+	effects_clear();
+	show_winner_text();
+	uint8_t score_screen_shown = 0;
 	while (button_pushed() == NO_BUTTON_PUSHED) {
-		led_matrix_score();
+		uint32_t current_time = get_current_time();
+		text_scroll_update(current_time);
+		if (!text_scroll_running() && !score_screen_shown) {
+			show_score_screen();
+			score_screen_shown = 1;
+		}
+		animation_update(current_time);
+		if (frame_due()) {
+			ledmatrix_commit_frame();
+			// Send any score changes left over from the game
+			term_screen_update();
+		}
 		if (serial_input_available()) {
 			char serial_input = fgetc(stdin);
 			if ((serial_input == 's') | (serial_input == 'S') | (button_pushed() != NO_BUTTON_PUSHED)) {
@@ -360,15 +478,50 @@ void handle_game_over() {
 	}
 }
 
+// Write a snapshot of the counters used to size the buffers and budgets on
+// the console's echo row (in place of the :stats line just typed), then
+// start them again from zero: the most bytes waiting in the SPI queue and
+// the times it was full, the frames that left changes for later, the
+// serial output characters dropped in each class and the serial input
+// overruns.
+void report_stats(void) {
+	SpiQueueStats queue_stats;
+	LedMatrixFrameStats frame_stats;
+	spi_get_queue_stats(&queue_stats);
+	ledmatrix_get_frame_stats(&frame_stats);
+	SerialClass previous_class = serial_set_class(SERIAL_NORMAL);
+	move_terminal_cursor(CONSOLE_ECHO_X, CONSOLE_ECHO_Y);
+	serial_put_string_P(PSTR("queue "));
+	serial_put_uint(queue_stats.high_water);
+	serial_put_string_P(PSTR(" full "));
+	serial_put_uint(queue_stats.full_count);
+	serial_put_string_P(PSTR(" deferred "));
+	serial_put_uint(frame_stats.frames_deferred);
+	serial_put_string_P(PSTR(" dropped "));
+	for (uint8_t i = 0; i < SERIAL_NUM_CLASSES; i++) {
+		if (i > 0) {
+			serial_put_char('/');
+		}
+		serial_put_uint(serial_output_dropped(i));
+	}
+	serial_put_string_P(PSTR(" overruns "));
+	serial_put_uint(serial_input_overruns());
+	clear_to_end_of_line();
+	serial_set_class(previous_class);
+	spi_reset_queue_stats();
+	ledmatrix_reset_frame_stats();
+	serial_reset_counts();
+}
+
 void pause_game(void) {
+	uint16_t argument;
 	while (1) {
-		if (serial_input_available()) {
-			char serial_input = fgetc(stdin);
-			if ((serial_input == 'p') | (serial_input == 'P')) {
-				move_terminal_cursor(32,50);
-				printf_P(PSTR("           "));
-				break;
-			}
+		term_screen_update();
+		// Only the pause command resumes - the rest are ignored
+		if (console_poll(&argument) == CONSOLE_PAUSE) {
+			// Blank the message (it is sent by the next update)
+			term_screen_set_text_P(paused_field, PSTR(""));
+			break;
 		}
 	}
 }
@@ -6,11 +6,13 @@
  * Module to allow standard input/output routines to be used via 
  * serial port 0. The init_serial_stdio() method must be called before
  * any standard IO methods (e.g. printf). We use interrupt-based output
- * and a circular buffer to store output messages. (This allows us 
- * to print many characters at once to the buffer and have them 
- * output by the UART as speed permits.) If the buffer fills up, the
- * put method will either
- * (1) if interrupts are enabled, block until there is room in it, or
+ * and a circular buffer for each priority class to store output messages.
+ * (This allows us to print many characters at once to the buffer and
+ * have them output by the UART as speed permits.) If a buffer fills up,
+ * the put method will either
+ * (1) if interrupts are enabled, follow the class's policy (see
+ * SERIAL_OUTPUT_FULL_POLICY in serialio.h) - block until there is room,
+ * or discard a character, or
  * (2) if interrupts are disabled, will discard the character.
  * Input is blocking - requesting input from stdin will block
  * until a character is available. If interrupts are disabled when 
@@ -25,35 +27,82 @@
 #include <stdint.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
-/* System clock rate in Hz. (L at the end indicates this is a long constant) */
-#define SYSCLK 8000000L
+/* The system clock rate in Hz, F_CPU, is defined for the whole project
+ * (in the project's compiler symbols), as it is also needed by
+ * <util/delay.h>.
+ */
+#ifndef F_CPU
+#error "F_CPU must be defined as the system clock rate in Hz"
+#endif
 
 /* Global variables */
-/* Circular buffer to hold outgoing characters. The insert_pos variable
- * keeps track of the position (0 to OUTPUT_BUFFER_SIZE-1) that the next
- * outgoing character should be written to. bytes_in_buffer keeps
- * count of the number of characters currently stored in the buffer 
- * (ranging from 0 to OUTPUT_BUFFER_SIZE). This number of bytes immediately
- * prior to the current insert_pos are the bytes waiting to be output.
- * If the insert_pos reaches the end of the buffer it will wrap around
- * to the beginning (assuming those bytes have been output).
- * NOTE - OUTPUT_BUFFER_SIZE can not be larger than 255 without changing
- * the type of the variables below (currently defined as 8 bit unsigned ints).
+/* Ring buffers for outgoing and incoming characters. Each has one writer
+ * and one reader: the main program writes the output rings and the UART
+ * Data Register Empty interrupt handler reads them; the Receive Complete
+ * interrupt handler writes the input ring and the main program reads it.
+ * The writer only ever changes the head (the position the next character
+ * goes in) and the reader only ever changes the tail (the position of the
+ * next character to be read), so neither needs to turn interrupts off -
+ * each position is a single byte, which is read and written in one go.
+ * The ring is empty when head == tail and full when advancing the head
+ * would make it equal to the tail, so a ring holds one character less
+ * than its size. The sizes are powers of two (set in serialio.h) so the
+ * positions wrap around with a mask.
+ */
+#define INPUT_MASK (SERIAL_INPUT_BUFFER_SIZE - 1)
+#define BAD_SIZE(size) (((size) & ((size) - 1)) || (size) > 256)
+#if BAD_SIZE(SERIAL_CRITICAL_BUFFER_SIZE) || BAD_SIZE(SERIAL_NORMAL_BUFFER_SIZE) \
+		|| BAD_SIZE(SERIAL_DEBUG_BUFFER_SIZE) || BAD_SIZE(SERIAL_INPUT_BUFFER_SIZE)
+#error "Serial buffer sizes must be powers of two no larger than 256"
+#endif
+static volatile char critical_buffer[SERIAL_CRITICAL_BUFFER_SIZE];
+static volatile char normal_buffer[SERIAL_NORMAL_BUFFER_SIZE];
+static volatile char debug_buffer[SERIAL_DEBUG_BUFFER_SIZE];
+static volatile char input_buffer[SERIAL_INPUT_BUFFER_SIZE];
+static volatile uint8_t input_head;
+static volatile uint8_t input_tail;
+
+/* An output ring, one per priority class. As well as the head and tail,
+ * the main program sets end to the head at the end of each message (see
+ * serial_set_class()). The interrupt handler only moves on to another
+ * class when the tail reaches the end of a message. length counts the
+ * characters written of the message being written (stopping at 255). If
+ * dropping is set, the rest of that message is thrown away. dropped counts
+ * the characters thrown away because the ring was full.
+ */
+typedef struct {
+	volatile char* buffer;
+	uint8_t mask;
+	uint8_t full_policy;
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	volatile uint8_t end;
+	uint8_t length;
+	uint8_t dropping;
+	uint16_t dropped;
+} OutputRing;
+
+static OutputRing out_rings[SERIAL_NUM_CLASSES] = {
+	{.buffer = critical_buffer, .mask = SERIAL_CRITICAL_BUFFER_SIZE - 1,
+			.full_policy = SERIAL_OUTPUT_FULL_POLICY},
+	{.buffer = normal_buffer, .mask = SERIAL_NORMAL_BUFFER_SIZE - 1,
+			.full_policy = SERIAL_OUTPUT_FULL_POLICY},
+	{.buffer = debug_buffer, .mask = SERIAL_DEBUG_BUFFER_SIZE - 1,
+			.full_policy = SERIAL_DROP_NEWEST}
+};
+
+/* The class the main program is writing to, and the class the interrupt
+ * handler is sending from
  */
-#define OUTPUT_BUFFER_SIZE 255
-volatile char out_buffer[OUTPUT_BUFFER_SIZE];
-volatile uint8_t out_insert_pos;
-volatile uint8_t bytes_in_out_buffer;
+static uint8_t out_class;
+static uint8_t sending_class;
 
-/* Circular buffer to hold incoming characters. Works on same principle
- * as output buffer
+/* Count of input characters thrown away because the input ring was full.
+ * It is only counted up by the receive interrupt handler.
  */
-#define INPUT_BUFFER_SIZE 16
-volatile char input_buffer[INPUT_BUFFER_SIZE];
-volatile uint8_t input_insert_pos;
-volatile uint8_t bytes_in_input_buffer;
-volatile uint8_t input_overrun;
+static volatile uint16_t input_overruns;
 
 /* Variable to keep track of whether incoming characters are to be echoed
  * back or not.
@@ -62,8 +111,10 @@ static int8_t do_echo;
 
 /* Function prototypes 
  */
-void init_serial_stdio(long baudrate, int8_t echo);
+uint8_t init_serial_stdio(long baudrate, int8_t echo);
 static int uart_put_char(char, FILE*);
+static int put_byte(uint8_t);
+static void drop_message(OutputRing*);
 static int uart_get_char(FILE*);
 
 /* Setup a stream that uses the uart get and put functions. We will
@@ -72,16 +123,59 @@ static int uart_get_char(FILE*);
 static FILE myStream = FDEV_SETUP_STREAM(uart_put_char, uart_get_char,
 		_FDEV_SETUP_RW);
 
-void init_serial_stdio(long baudrate, int8_t echo) {
-	uint16_t ubrr;
+/* Work out the UBRR value giving the rate closest to baudrate when the
+ * UART divides the clock by divider (16 in normal mode, 8 in double speed
+ * mode) as well as by UBRR + 1. Returns how far the rate is out in Hz, or
+ * UINT32_MAX if the rate can't be made at all.
+ */
+static uint32_t baud_setting(uint32_t baudrate, uint8_t divider,
+		uint16_t* ubrr) {
+	/* Round to the nearest divisor, using integer division (which
+	 * truncates) */
+	uint32_t divisor = (F_CPU + divider * baudrate / 2)
+			/ (divider * baudrate);
+	if (divisor == 0 || divisor > 4096) {
+		return UINT32_MAX;
+	}
+	*ubrr = divisor - 1;
+	uint32_t actual = F_CPU / (divider * divisor);
+	return (actual > baudrate) ? actual - baudrate : baudrate - actual;
+}
+
+uint8_t init_serial_stdio(long baudrate, int8_t echo) {
+	/* Choose normal or double speed mode, whichever gets closer to the
+	 * rate. Normal mode samples each bit more times, so it copes better
+	 * with noise and is used when they are as close as each other.
+	 */
+	if (baudrate <= 0) {
+		return 0;
+	}
+	uint16_t normal_ubrr;
+	uint16_t double_ubrr;
+	uint32_t normal_error = baud_setting(baudrate, 16, &normal_ubrr);
+	uint32_t double_error = baud_setting(baudrate, 8, &double_ubrr);
+	uint8_t double_speed = double_error < normal_error;
+	uint32_t error = double_speed ? double_error : normal_error;
+	if (error == UINT32_MAX
+			|| error * 1000 > (uint32_t)SERIAL_MAX_BAUD_ERROR * baudrate) {
+		return 0;
+	}
+
 	/*
 	 * Initialise our buffers
 	*/
-	out_insert_pos = 0;
-	bytes_in_out_buffer = 0;
-	input_insert_pos = 0;
-	bytes_in_input_buffer = 0;
-	input_overrun = 0;
+	for (uint8_t i = 0; i < SERIAL_NUM_CLASSES; i++) {
+		out_rings[i].head = 0;
+		out_rings[i].tail = 0;
+		out_rings[i].end = 0;
+		out_rings[i].dropping = 0;
+		out_rings[i].dropped = 0;
+	}
+	out_class = SERIAL_NORMAL;
+	sending_class = SERIAL_NORMAL;
+	input_head = 0;
+	input_tail = 0;
+	input_overruns = 0;
 	
 	/*
 	 * Record whether we're going to echo characters or not
@@ -89,12 +183,13 @@ void init_serial_stdio(long baudrate, int8_t echo) {
 	do_echo = echo;
 	
 	/* Configure the serial port baud rate */
-	/* (This differs from the datasheet formula so that we get 
-	 * rounding to the nearest integer while using integer division
-	 * (which truncates)).
-	*/
-	ubrr = (((SYSCLK / (8 * baudrate)) + 1) / 2) - 1;
-	UBRR0 = ubrr;
+	if (double_speed) {
+		UCSR0A |= (1 << U2X0);
+		UBRR0 = double_ubrr;
+	} else {
+		UCSR0A &= ~(1 << U2X0);
+		UBRR0 = normal_ubrr;
+	}
 	
 	/*
 	 * Enable transmission and receiving via UART. We don't enable
@@ -116,99 +211,229 @@ void init_serial_stdio(long baudrate, int8_t echo) {
 	*/
 	stdout = &myStream;
 	stdin = &myStream;
+	return 1;
 }
 
 int8_t serial_input_available(void) {
-	return bytes_in_input_buffer != 0;
+	return input_head != input_tail;
 }
 
 void clear_serial_input_buffer(void) {
-	/* Just adjust our buffer data so it looks empty */
-	input_insert_pos = 0;
-	bytes_in_input_buffer = 0;
+	/* Just move our read position up to the write position so the buffer
+	 * looks empty
+	 */
+	input_tail = input_head;
 }
 
-static int uart_put_char(char c, FILE* stream) {
-	uint8_t interrupts_enabled;
+SerialClass serial_set_class(SerialClass output_class) {
+	SerialClass previous = out_class;
+	OutputRing* ring = &out_rings[previous];
+	ring->end = ring->head;
+	ring->length = 0;
+	ring->dropping = 0;
+	out_class = output_class;
 	
-	/* Add the character to the buffer for transmission (if there 
-	 * is space to do so). If not we wait until the buffer has space.
-	 * If the character is \n, we output \r (carriage return)
-	 * also.
+	/* The interrupt handler may have stopped to wait for the rest of the
+	 * message - it can now go on to the next one.
+	 */
+	UCSR0B |= (1 << UDRIE0);
+	return previous;
+}
+
+uint8_t serial_output_space(void) {
+	OutputRing* ring = &out_rings[out_class];
+	return (ring->tail - ring->head - 1) & ring->mask;
+}
+
+uint16_t serial_output_dropped(SerialClass output_class) {
+	return out_rings[output_class].dropped;
+}
+
+uint16_t serial_input_overruns(void) {
+	/* The count is 16 bits and may be changed by the receive interrupt
+	 * handler part way through reading it, so read it until we get the
+	 * same value twice.
+	 */
+	uint16_t count;
+	do {
+		count = input_overruns;
+	} while (count != input_overruns);
+	return count;
+}
+
+void serial_reset_counts(void) {
+	for (uint8_t i = 0; i < SERIAL_NUM_CLASSES; i++) {
+		out_rings[i].dropped = 0;
+	}
+	/* Stop the receive interrupt handler counting part way through */
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	input_overruns = 0;
+	if (interrupts_were_enabled) {
+		sei();
+	}
+}
+
+void serial_put_char(char c) {
+	uart_put_char(c, NULL);
+}
+
+void serial_put_bytes(const uint8_t* data, uint8_t length) {
+	for (uint8_t i = 0; i < length; i++) {
+		put_byte(data[i]);
+	}
+}
+
+void serial_put_string_P(const char* string) {
+	char c;
+	while ((c = pgm_read_byte(string++)) != '\0') {
+		uart_put_char(c, NULL);
+	}
+}
+
+/* Powers of ten for each decimal digit of a 16 bit number but the last.
+ * Each digit is found by subtracting its power of ten until the value is
+ * less than it, which takes no more than 9 subtractions - far quicker than
+ * dividing by 10 on the AVR, which has no divide instruction.
+ */
+static const uint16_t powers_of_ten[] PROGMEM = {10000, 1000, 100, 10};
+
+uint8_t serial_format_uint(uint16_t value, char* buffer) {
+	uint8_t length = 0;
+	for (uint8_t i = 0; i < sizeof(powers_of_ten) / sizeof(uint16_t); i++) {
+		uint16_t power = pgm_read_word(&powers_of_ten[i]);
+		char digit = '0';
+		while (value >= power) {
+			value -= power;
+			digit++;
+		}
+		/* Leave out leading zeros */
+		if (digit != '0' || length != 0) {
+			buffer[length++] = digit;
+		}
+	}
+	buffer[length++] = '0' + value;
+	return length;
+}
+
+void serial_put_uint(uint16_t value) {
+	char digits[5];
+	uint8_t length = serial_format_uint(value, digits);
+	for (uint8_t i = 0; i < length; i++) {
+		uart_put_char(digits[i], NULL);
+	}
+}
+
+static int uart_put_char(char c, FILE* stream) {
+	/* Add the character to the ring for transmission. If the character
+	 * is \n, we output \r (carriage return) also.
 	*/
 	if (c == '\n') {
-		uart_put_char('\r', stream);
+		put_byte('\r');
 	}
+	return put_byte(c);
+}
 	
-	/* If the buffer is full and interrupts are disabled then we
-	 * abort - we don't output the character since the buffer will
-	 * never be emptied if interrupts are disabled. If the buffer is full
-	 * and interrupts are enabled then we loop until the buffer has 
-	 * enough space. The bytes_in_buffer variable will get modified by the
-	 * ISR which extracts bytes from the buffer.
-	*/
-	interrupts_enabled = bit_is_set(SREG, SREG_I);
-	while (bytes_in_out_buffer >= OUTPUT_BUFFER_SIZE) {
-		if (!interrupts_enabled) {
+/* Throw away the message being written to a full ring, along with the
+ * rest of it as it is written, so no part of it is sent. The message is
+ * the last length characters in the ring - or fewer, if the interrupt
+ * handler has already started sending it, in which case only the part
+ * still in the ring can be thrown away.
+ */
+static void drop_message(OutputRing* ring) {
+	/* Hold off the UDRE interrupt so the tail stays put while we look at
+	 * it
+	 */
+	UCSR0B &= ~(1 << UDRIE0);
+	uint8_t unsent = (ring->head - ring->tail) & ring->mask;
+	if (unsent > ring->length) {
+		unsent = ring->length;
+	}
+	ring->head = (ring->head - unsent) & ring->mask;
+	/* The new character is thrown away too */
+	ring->dropped += unsent + 1;
+	ring->dropping = 1;
+	UCSR0B |= (1 << UDRIE0);
+}
+
+/* Add a byte to the current class's ring for transmission, as it is */
+static int put_byte(uint8_t c) {
+	OutputRing* ring = &out_rings[out_class];
+	if (ring->dropping) {
+		ring->dropped++;
+		return 1;
+	}
+	uint8_t next_head = (ring->head + 1) & ring->mask;
+	if (next_head == ring->tail) {
+		/* The ring is full. If interrupts are disabled it will never be
+		 * emptied, so the character has to be dropped whatever the
+		 * policy.
+		 */
+		if (ring->full_policy == SERIAL_DROP_NEWEST
+				|| !bit_is_set(SREG, SREG_I)) {
+			drop_message(ring);
 			return 1;
 		}		
-		/* else do nothing */
+		if (ring->full_policy == SERIAL_DROP_OLDEST) {
+			/* Only the UDRE interrupt handler moves the tail, so we hold
+			 * off just that interrupt while we throw away the oldest
+			 * character. If that character starts the message being
+			 * written, the message now starts at the next one - the end
+			 * of the previous message has to stay level with the tail
+			 * or the interrupt handler would not see it.
+			*/
+			UCSR0B &= ~(1 << UDRIE0);
+			uint8_t tail = ring->tail;
+			if (next_head == tail) {
+				if (tail == ring->end) {
+					ring->end = (tail + 1) & ring->mask;
+				}
+				ring->tail = (tail + 1) & ring->mask;
+				ring->dropped++;
+			}
+		} else {
+			/* Wait until the interrupt handler has made room. (It will,
+			 * as only the current class can have a message that hasn't
+			 * been ended.)
+			 */
+			while (next_head == ring->tail) {
+				/* do nothing */
+			}
+		}
 	}
 	
-	/* Add the character to the buffer for transmission if there
-	 * is space to do so. We advance the insert_pos to the next
-	 * character position. If this is beyond the end of the buffer
-	 * we wrap around back to the beginning of the buffer 
-	 * NOTE: we disable interrupts before modifying the buffer. This
-	 * prevents the ISR from modifying the buffer at the same time.
-	 * We reenable them if they were enabled when we entered the
-	 * function.
+	/* Store the character, then publish it by moving the head on. The
+	 * UDR Empty interrupt may have been disabled (when the rings last
+	 * emptied) - we ensure it is now enabled so that it will fire and
+	 * deal with the next character in the ring.
 	*/	
-	cli();
-	out_buffer[out_insert_pos++] = c;
-	bytes_in_out_buffer++;
-	if (out_insert_pos == OUTPUT_BUFFER_SIZE) {
-		/* Wrap around buffer pointer if necessary */
-		out_insert_pos = 0;
+	ring->buffer[ring->head] = c;
+	ring->head = next_head;
+	if (ring->length != 255) {
+		ring->length++;
 	}
-	/* Reenable interrupts (UDR Empty interrupt may have been
-	 * disabled) - we ensure it is now enabled so that it will
-	 * fire and deal with the next character in the buffer. */
 	UCSR0B |= (1 << UDRIE0);
-	if (interrupts_enabled) {
-		sei();
-	}
 	return 0;
 }
 
 int uart_get_char(FILE* stream) {
 	/* Wait until we've received a character */
-	while (bytes_in_input_buffer == 0) {
+	while (input_head == input_tail) {
 		/* do nothing */
 	}
 	
-	/*
-	 * Turn interrupts off and remove a character from the input
-	 * buffer. We reenable interrupts if they were on.
-	 * The pending character is the one which is byte_in_input_buffer
-	 * characters before the insert position (taking into account
-	 * that we may need to wrap around).
+	/* Take the character from the ring then move the tail on, which
+	 * frees its place for the interrupt handler.
 	 */
-	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
-	cli();
-	char c;
-	if (input_insert_pos - bytes_in_input_buffer < 0) {
-		/* Need to wrap around */
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer
-				+ INPUT_BUFFER_SIZE];
-	} else {
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer];
-	}
+	char c = input_buffer[input_tail];
+	input_tail = (input_tail + 1) & INPUT_MASK;
 	
-	/* Decrement our count of bytes in the input buffer */
-	bytes_in_input_buffer--;
-	if (interrupts_enabled) {
-		sei();
+	/* Echo the character if required. This is done here rather than in
+	 * the interrupt handler so that the output ring only ever has one
+	 * writer.
+	 */
+	if (do_echo) {
+		uart_put_char(c, stream);
 	}	
 	return c;
 }
@@ -219,38 +444,41 @@ int uart_get_char(FILE* stream) {
  */
 ISR(USART0_UDRE_vect) 
 {
-	/* Check if we have data in our buffer */
-	if (bytes_in_out_buffer > 0) {
-		/* Yes we do - remove the pending byte and output it
-		 * via the UART. The pending byte (character) is the
-		 * one which is "bytes_in_buffer" characters before the 
-		 * insert_pos (taking into account that we may 
-		 * need to wrap around to the end of the buffer).
+	OutputRing* ring = &out_rings[sending_class];
+	uint8_t tail = ring->tail;
+	if (tail == ring->end) {
+		/* At the end of a message - go on to the highest class with
+		 * anything waiting
 		 */
-		char c;
-		if (out_insert_pos - bytes_in_out_buffer < 0) {
-			/* Need to wrap around */
-			c = out_buffer[out_insert_pos - bytes_in_out_buffer
-				+ OUTPUT_BUFFER_SIZE];
-		} else {
-			c = out_buffer[out_insert_pos - bytes_in_out_buffer];
+		uint8_t output_class = 0;
+		ring = &out_rings[0];
+		while (ring->tail == ring->head) {
+			output_class++;
+			ring++;
+			if (output_class == SERIAL_NUM_CLASSES) {
+				/* No data in the buffers. We disable the UART Data
+				 * Register Empty interrupt because otherwise it 
+				 * will trigger again immediately this ISR exits. 
+				 * The interrupt is reenabled when a character is
+				 * placed in a buffer.
+				 */
+				UCSR0B &= ~(1 << UDRIE0);
+				return;
+			}
 		}
-		/* Decrement our count of the number of bytes in the 
-		 * buffer 
-		 */
-		bytes_in_out_buffer--;
-		
-		/* Output the character via the UART */
-		UDR0 = c;
-	} else {
-		/* No data in the buffer. We disable the UART Data
-		 * Register Empty interrupt because otherwise it 
-		 * will trigger again immediately this ISR exits. 
-		 * The interrupt is reenabled when a character is
-		 * placed in the buffer.
+		sending_class = output_class;
+		tail = ring->tail;
+	}
+	if (tail == ring->head) {
+		/* The rest of the message hasn't been written yet. The interrupt
+		 * is reenabled when it is, or when the message is ended.
 		 */
 		UCSR0B &= ~(1 << UDRIE0);
+		return;
 	}
+	/* Output the next character via the UART and free its place */
+	UDR0 = ring->buffer[tail];
+	ring->tail = (tail + 1) & ring->mask;
 }
 
 /*
@@ -262,42 +490,22 @@ ISR(USART0_UDRE_vect)
 ISR(USART0_RX_vect) 
 {
 	/* Read the character - we ignore the possibility of overrun. */
-	char c;
-	c = UDR0;
+	char c = UDR0;
 		
-	if (do_echo && bytes_in_out_buffer < OUTPUT_BUFFER_SIZE) {
-		/* If echoing is enabled and there is output buffer
-		 * space, echo the received character back to the UART.
-		 * (If there is no output buffer space, characters
-		 * will be lost.)
-		 */
-		uart_put_char(c, 0);
+	/* If the character is a carriage return, turn it into a linefeed */
+	if (c == '\r') {
+		c = '\n';
 	}
 	
-	/* 
-	 * Check if we have space in our buffer. If not, set the overrun
-	 * flag and throw away the character. (We never clear the 
-	 * overrun flag - it's up to the programmer to check/clear
-	 * this flag if desired.)
+	/* Check if we have space in our buffer. If not, count the overrun
+	 * and throw away the character.
 	 */
-	if (bytes_in_input_buffer >= INPUT_BUFFER_SIZE) {
-		input_overrun = 1;
+	uint8_t head = input_head;
+	uint8_t next_head = (head + 1) & INPUT_MASK;
+	if (next_head == input_tail) {
+		input_overruns++;
 	} else {
-		/* If the character is a carriage return, turn it into a
-		 * linefeed 
-		*/
-		if (c == '\r') {
-			c = '\n';
-		}
-		
-		/* 
-		 * There is room in the input buffer 
-		 */
-		input_buffer[input_insert_pos++] = c;
-		bytes_in_input_buffer++;
-		if (input_insert_pos == INPUT_BUFFER_SIZE) {
-			/* Wrap around buffer pointer if necessary */
-			input_insert_pos = 0;
-		}
+		input_buffer[head] = c;
+		input_head = next_head;
 	}
 }
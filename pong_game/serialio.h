@@ -18,12 +18,79 @@
 
 #include <stdint.h>
 
+/* Output priority classes. Each class has its own output buffer. Output
+ * is sent a message at a time, where a message is everything written to a
+ * class between calls to serial_set_class(). At the end of each message
+ * the UART goes on to the next message in the highest class with one
+ * waiting, so critical output (e.g. the game's HUD) never waits behind
+ * normal or debug output. Messages are never mixed together, so escape
+ * sequences aren't broken up - except that a message longer than its
+ * class's buffer may have others sent part way through it. As other
+ * classes' messages may be sent between two messages of a class, a message
+ * that writes to the terminal should start by moving the cursor where it
+ * wants it.
+ */
+typedef enum {
+	SERIAL_CRITICAL,
+	SERIAL_NORMAL,
+	SERIAL_DEBUG,
+	SERIAL_NUM_CLASSES
+} SerialClass;
+
+/* Sizes of the output buffers for each class and of the input buffer.
+ * Each must be a power of two, no larger than 256. A buffer holds one
+ * character less than its size.
+ */
+#ifndef SERIAL_CRITICAL_BUFFER_SIZE
+#define SERIAL_CRITICAL_BUFFER_SIZE 64
+#endif
+#ifndef SERIAL_NORMAL_BUFFER_SIZE
+#define SERIAL_NORMAL_BUFFER_SIZE 128
+#endif
+#ifndef SERIAL_DEBUG_BUFFER_SIZE
+#define SERIAL_DEBUG_BUFFER_SIZE 64
+#endif
+#ifndef SERIAL_INPUT_BUFFER_SIZE
+#define SERIAL_INPUT_BUFFER_SIZE 64
+#endif
+
+/* What writing a critical or normal character does when its class's
+ * output buffer is full: SERIAL_BLOCK waits for the UART to make room,
+ * SERIAL_DROP_NEWEST throws away the message the new character is part of
+ * - what has been written of it and the rest of it - so the message isn't
+ * sent cut short and an escape sequence is never sent in part (unless the
+ * UART had already started on the message), and SERIAL_DROP_OLDEST throws
+ * away the oldest character waiting to be sent to make room for it.
+ * Debug output always follows SERIAL_DROP_NEWEST, so it never holds up the
+ * program. Dropped characters are counted (see serial_output_dropped()).
+ * Input that arrives when the input buffer is full is always thrown away
+ * and counted (see serial_input_overruns()).
+ */
+#define SERIAL_BLOCK 0
+#define SERIAL_DROP_NEWEST 1
+#define SERIAL_DROP_OLDEST 2
+#ifndef SERIAL_OUTPUT_FULL_POLICY
+#define SERIAL_OUTPUT_FULL_POLICY SERIAL_BLOCK
+#endif
+
+/* Largest error in the baud rate init_serial_stdio() accepts, in tenths
+ * of a percent. Both ends' errors add up, and a few percent in all is
+ * enough to garble characters.
+ */
+#ifndef SERIAL_MAX_BAUD_ERROR
+#define SERIAL_MAX_BAUD_ERROR 20
+#endif
+
 /* Initialise serial IO using the UART. baudrate specifies the desired
  * baud rate (e.g. 19200) and echo determines whether incoming characters
  * are echoed back to the UART output as they are received (zero means no
- * echo, non-zero means echo)
+ * echo, non-zero means echo). The UART uses double speed (U2X) mode if
+ * that gets closer to the rate, so with an 8MHz clock 250000, 500000 and
+ * 1000000 baud are exact (but 57600 and 115200 are too far out).
+ * Returns 1 if the UART is set up, or 0 if the rate can't be made within
+ * SERIAL_MAX_BAUD_ERROR of baudrate - then nothing is changed.
  */
-void init_serial_stdio(long baudrate, int8_t echo);
+uint8_t init_serial_stdio(long baudrate, int8_t echo);
 
 /* Test if input is available from the serial port. Return 0 if not,
  * non-zero otherwise. If there is input available then it can be read
@@ -36,5 +103,44 @@ int8_t serial_input_available(void);
  */
 void clear_serial_input_buffer(void);
 
+/* End the message being written, and write the following output to class
+ * output_class (until the next call). Returns the class output was going
+ * to, so it can be put back. Output starts off going to SERIAL_NORMAL.
+ */
+SerialClass serial_set_class(SerialClass output_class);
+
+/* Return the number of characters that can be written to the serial port
+ * right now without waiting for room in the current class's output
+ * buffer.
+ */
+uint8_t serial_output_space(void);
+
+/* Return the number of characters of a class thrown away because its
+ * output buffer was full, and the number of input characters thrown away
+ * because the input buffer was full (both wrapping around at 65536).
+ * serial_reset_counts() sets all of these back to 0.
+ */
+uint16_t serial_output_dropped(SerialClass output_class);
+uint16_t serial_input_overruns(void);
+void serial_reset_counts(void);
+
+/* Write straight to the output buffer, without going through the standard
+ * IO library and its format parsing. These wait (or drop characters) as
+ * described above if the buffer is full. serial_put_string_P() writes a
+ * string from flash (e.g. from PSTR()) and serial_put_uint() writes a
+ * number in decimal. serial_put_bytes() writes binary data as it is -
+ * unlike the others it doesn't add a \r before each \n.
+ */
+void serial_put_char(char c);
+void serial_put_bytes(const uint8_t* data, uint8_t length);
+void serial_put_string_P(const char* string);
+void serial_put_uint(uint16_t value);
+
+/* Write value in decimal into buffer (which must have room for 5
+ * characters), without a terminating null. Returns the number of
+ * characters written.
+ */
+uint8_t serial_format_uint(uint16_t value, char* buffer);
+
 
 #endif /* SERIALIO_H_ */
@@ -6,8 +6,83 @@
 
 #include "spi.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
+
+// Transmit queue. Bytes are added at queue_head by spi_queue_byte() and
+// removed from queue_tail by the SPI transfer complete interrupt. Both
+// indices are free running 8 bit values - the number of bytes waiting is
+// always (queue_head - queue_tail) and the array position is found by
+// masking with SPI_QUEUE_SIZE - 1 (which is why the size must be a power
+// of two no larger than 128). The byte currently being shifted out is not
+// held in the queue - transfer_in_progress records that SPDR0 is busy.
+#define SPI_QUEUE_MASK (SPI_QUEUE_SIZE - 1)
+static volatile uint8_t spi_queue[SPI_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
+static volatile uint8_t transfer_in_progress;
+
+// Command pacing. spi_end_command() sets a bit in command_end_marks for the
+// last byte of each command. When a marked byte has been sent we wait
+// command_gap microseconds (timed by timer 2) before starting the next byte,
+// giving the LED matrix time to act on the command. in_flight_ends_command
+// records whether the byte being shifted out now is marked.
+static volatile uint8_t command_end_marks[SPI_QUEUE_SIZE / 8];
+static volatile uint8_t in_flight_ends_command;
+static volatile uint8_t command_gap;
+
+// Slave select framing - see spi_set_command_framing(). The SS line of the
+// device a byte is for is taken low before the byte is sent (which does
+// nothing if it is low already) and, when framing, high after the end of
+// a command.
+static volatile uint8_t command_framing;
+
+#if SPI_NUM_DEVICES > 1
+// Devices - see spi_select_device(). selected_device is the device bytes
+// are being queued for, queue_device holds the device each queued byte is
+// for, and active_device is the device whose SS line is (or was last)
+// low. Switching devices raises the old device's SS line before lowering
+// the new one's.
+static volatile uint8_t queue_device[SPI_QUEUE_SIZE];
+static volatile uint8_t selected_device;
+static volatile uint8_t active_device;
+
+static void set_slave_select(uint8_t device, uint8_t high) {
+	volatile uint8_t* port = (device == 0) ? &PORTB : &PORTA;
+	uint8_t pin = (device == 0) ? PORTB4 : device - 1;
+	if (high) {
+		*port |= (1 << pin);
+	} else {
+		*port &= ~(1 << pin);
+	}
+}
+
+static void select_slave(uint8_t device) {
+	if (device != active_device) {
+		set_slave_select(active_device, 1);
+		active_device = device;
+	}
+	set_slave_select(device, 0);
+}
+#define SELECT_SLAVE(device)	select_slave(device)
+#define DESELECT_SLAVE()		set_slave_select(active_device, 1)
+#define SELECTED_DEVICE			selected_device
+#define QUEUED_DEVICE(index)	queue_device[index]
+#else
+#define SELECT_SLAVE(device)	(PORTB &= ~(1 << PORTB4))
+#define DESELECT_SLAVE()		(PORTB |= (1 << PORTB4))
+#define SELECTED_DEVICE			0
+#define QUEUED_DEVICE(index)	0
+#endif
+
+// Queue statistics - see spi_get_queue_stats()
+static volatile uint8_t queue_high_water;
+static volatile uint16_t queue_full_count;
 
 void spi_setup_master(uint8_t clockdivider) {
+	// Let anything already queued go out at the old speed before we
+	// touch the control registers
+	spi_wait_until_idle();
+
 	// Set up SPI communication as a master
 	// Make the SS, MOSI and SCK pins outputs. These are pins
 	// 4, 5 and 7 of port B on the ATmega324A
@@ -15,11 +90,19 @@ void spi_setup_master(uint8_t clockdivider) {
 	
 	// Set the slave select (SS) line high
 	PORTB |= (1 << PORTB4);
+#if SPI_NUM_DEVICES > 1
+	// and those of the other devices
+	for (uint8_t device = 1; device < SPI_NUM_DEVICES; device++) {
+		DDRA |= (1 << (device - 1));
+		PORTA |= (1 << (device - 1));
+	}
+#endif
 	
 	// Set up the SPI control registers SPCR and SPSR:
 	// - SPE bit = 1 (SPI is enabled)
 	// - MSTR bit = 1 (Master Mode)
-	SPCR0 = (1 << SPE0) | (1 << MSTR0);
+	// - SPIE bit = 1 (transfer complete interrupt drives the queue)
+	SPCR0 = (1 << SPE0) | (1 << MSTR0) | (1 << SPIE0);
 	
 	// Set SPR0 and SPR1 bits in SPCR and SPI2X bit in SPSR
 	// based on the given clock divider
@@ -49,11 +132,192 @@ void spi_setup_master(uint8_t clockdivider) {
 			break;
 	}
 	
-	// Take SS (slave select) line low
-	PORTB &= ~(1 << PORTB4);
+	// Take SS (slave select) line low, unless we are framing commands (in
+	// which case it goes low when the next command starts)
+	if (!command_framing) {
+		SELECT_SLAVE(SELECTED_DEVICE);
+	}
+}
+
+void spi_set_command_gap(uint8_t microseconds) {
+	spi_wait_until_idle();
+	command_gap = microseconds;
+}
+
+void spi_set_command_framing(uint8_t on) {
+	spi_wait_until_idle();
+	command_framing = on;
+	if (on) {
+		DESELECT_SLAVE();
+	} else {
+		SELECT_SLAVE(SELECTED_DEVICE);
+	}
+}
+
+void spi_select_device(uint8_t device) {
+#if SPI_NUM_DEVICES > 1
+	if (device < SPI_NUM_DEVICES) {
+		selected_device = device;
+	}
+#else
+	(void)device;
+#endif
+}
+
+// Start the next queued transfer, or mark the transmitter idle if there
+// is nothing left to send.
+static void spi_start_next_transfer(void) {
+	if (queue_head != queue_tail) {
+		uint8_t index = queue_tail & SPI_QUEUE_MASK;
+		in_flight_ends_command = command_end_marks[index >> 3] & (1 << (index & 7));
+		SELECT_SLAVE(QUEUED_DEVICE(index));
+		SPDR0 = spi_queue[index];
+		queue_tail++;
+	} else {
+		transfer_in_progress = 0;
+	}
+}
+
+// Start timer 2 counting out the command gap. We divide the 8MHz clock by
+// 8 so each count is one microsecond, and the compare match interrupt
+// fires when the gap is over. transfer_in_progress stays set while we wait
+// so that new bytes are queued rather than sent.
+static void spi_start_gap_timer(void) {
+	TCNT2 = 0;
+	OCR2A = command_gap - 1;
+	TCCR2A = (1 << WGM21);
+	TIFR2 = (1 << OCF2A);
+	TIMSK2 |= (1 << OCIE2A);
+	TCCR2B = (1 << CS21);
+}
+
+static void spi_stop_gap_timer(void) {
+	TCCR2B = 0;
+	TIMSK2 &= ~(1 << OCIE2A);
+	TIFR2 = (1 << OCF2A);
+}
+
+// Called when a transfer has completed (from the interrupt handler, or with
+// interrupts disabled when we have to poll).
+static void spi_transfer_complete(void) {
+	if (in_flight_ends_command) {
+		in_flight_ends_command = 0;
+		if (command_framing) {
+			DESELECT_SLAVE();
+		}
+		if (command_gap) {
+			spi_start_gap_timer();
+			return;
+		}
+	}
+	spi_start_next_transfer();
+}
+
+// Do the work of the interrupt handlers when interrupts are disabled
+static void spi_poll(void) {
+	if (TCCR2B) {
+		if (TIFR2 & (1 << OCF2A)) {
+			spi_stop_gap_timer();
+			spi_start_next_transfer();
+		}
+	} else if (SPSR0 & (1 << SPIF0)) {
+		// Reading SPSR0 with SPIF0 set followed by reading SPDR0 clears
+		// the flag
+		(void)SPDR0;
+		spi_transfer_complete();
+	}
+}
+
+void spi_queue_byte(uint8_t byte) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+
+	// If the queue is full we have to wait for the interrupt handler to
+	// make room. If interrupts are off it never will, so we poll the
+	// transfer complete flag and move the queue along ourselves.
+	if ((uint8_t)(queue_head - queue_tail) >= SPI_QUEUE_SIZE) {
+		queue_full_count++;
+		while ((uint8_t)(queue_head - queue_tail) >= SPI_QUEUE_SIZE) {
+			if (!interrupts_were_enabled) {
+				spi_poll();
+			}
+		}
+	}
+
+	cli();
+	if (!transfer_in_progress) {
+		// Transmitter is idle - start this byte straight away
+		transfer_in_progress = 1;
+		in_flight_ends_command = 0;
+		SELECT_SLAVE(SELECTED_DEVICE);
+		SPDR0 = byte;
+	} else {
+		uint8_t index = queue_head & SPI_QUEUE_MASK;
+		spi_queue[index] = byte;
+		command_end_marks[index >> 3] &= ~(1 << (index & 7));
+#if SPI_NUM_DEVICES > 1
+		queue_device[index] = selected_device;
+#endif
+		queue_head++;
+		uint8_t bytes_waiting = queue_head - queue_tail;
+		if (bytes_waiting > queue_high_water) {
+			queue_high_water = bytes_waiting;
+		}
+	}
+	if (interrupts_were_enabled) {
+		sei();
+	}
+}
+
+uint8_t spi_queue_space(void) {
+	// Bytes only ever leave the queue behind our back, so reading the
+	// indices without turning interrupts off can only underestimate this
+	return SPI_QUEUE_SIZE - (uint8_t)(queue_head - queue_tail);
+}
+
+void spi_end_command(void) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	if (queue_head != queue_tail) {
+		// The last byte of the command is still in the queue
+		uint8_t index = (queue_head - 1) & SPI_QUEUE_MASK;
+		command_end_marks[index >> 3] |= (1 << (index & 7));
+	} else if (transfer_in_progress) {
+		// The last byte of the command is being shifted out (or we are
+		// already waiting out a gap, in which case this does nothing)
+		in_flight_ends_command = 1;
+	} else {
+		// The last byte has already gone - end the command now
+		if (command_framing) {
+			DESELECT_SLAVE();
+		}
+		if (command_gap) {
+			transfer_in_progress = 1;
+			spi_start_gap_timer();
+		}
+	}
+	if (interrupts_were_enabled) {
+		sei();
+	}
+}
+
+void spi_wait_until_idle(void) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	while (transfer_in_progress) {
+		if (!interrupts_were_enabled) {
+			spi_poll();
+		}
+	}
 }
 
 uint8_t spi_send_byte(uint8_t byte) {
+	// Anything queued must go out first so bytes stay in order
+	spi_wait_until_idle();
+
+	// We poll for this transfer, so stop the interrupt handler from
+	// claiming the transfer complete flag out from under us
+	SPCR0 &= ~(1 << SPIE0);
+	SELECT_SLAVE(SELECTED_DEVICE);
+
 	// Write out the byte to the SPDR0 register. This will initiate
 	// the transfer. We then wait until the most significant byte of
 	// SPSR0 (SPIF0 bit) is set - this indicates that the transfer is
@@ -64,5 +328,41 @@ uint8_t spi_send_byte(uint8_t byte) {
 	while ((SPSR0 & (1 << SPIF0)) == 0) {
 		; // wait
 	}
-	return SPDR0;
+	uint8_t received = SPDR0;
+
+	SPCR0 |= (1 << SPIE0);
+	return received;
+}
+
+void spi_get_queue_stats(SpiQueueStats* stats) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	stats->bytes_waiting = queue_head - queue_tail;
+	stats->high_water = queue_high_water;
+	stats->full_count = queue_full_count;
+	if (interrupts_were_enabled) {
+		sei();
+	}
+}
+
+void spi_reset_queue_stats(void) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	queue_high_water = 0;
+	queue_full_count = 0;
+	if (interrupts_were_enabled) {
+		sei();
+	}
+}
+
+// Interrupt handler for SPI transfer complete. The SPIF0 flag is cleared
+// by hardware when this handler runs.
+ISR(SPI_STC_vect) {
+	spi_transfer_complete();
+}
+
+// Interrupt handler for the end of a command gap
+ISR(TIMER2_COMPA_vect) {
+	spi_stop_gap_timer();
+	spi_start_next_transfer();
 }
@@ -9,12 +9,75 @@
 
 #include <stdint.h>
 
+// Number of bytes that can wait in the transmit queue (in addition to the
+// byte being shifted out). Must be a power of two no larger than 128.
+#ifndef SPI_QUEUE_SIZE
+#define SPI_QUEUE_SIZE 64
+#endif
+
+// Number of devices on the bus, each with its own slave select (SS) line.
+// Device 0 uses the SS pin (pin 4 of port B). Device n (from 1) uses pin
+// n - 1 of port A.
+#ifndef SPI_NUM_DEVICES
+#define SPI_NUM_DEVICES 1
+#endif
+
+// Snapshot of the transmit queue statistics. high_water is the most bytes
+// ever waiting at once and full_count is the number of times a caller of
+// spi_queue_byte() found the queue full and had to wait.
+typedef struct {
+	uint8_t bytes_waiting;
+	uint8_t high_water;
+	uint16_t full_count;
+} SpiQueueStats;
+
 // Set up SPI communication as a master.
 // clockdivider should be one of 2,4,8,16,32,64,128
+// Any bytes still queued are sent (at the old speed) before the
+// clock is changed.
 void spi_setup_master(uint8_t clockdivider);
 
-// Send and receive an SPI byte. This function will take at least 8 
-// cyles of the divided clock (i.e. will busy wait).
+// Queue a byte for transmission and return immediately. Bytes are sent in
+// order by the SPI transfer complete interrupt. If the queue is full this
+// will wait until there is room (if interrupts are disabled the queue is
+// drained by polling).
+void spi_queue_byte(uint8_t byte);
+
+// Returns the number of bytes that can be queued now without
+// spi_queue_byte() having to wait.
+uint8_t spi_queue_space(void);
+
+// Mark the end of a command made up of the bytes queued so far. If a
+// command gap has been set, the next byte will not be sent until that many
+// microseconds after the last byte of the command has gone out.
+void spi_end_command(void);
+
+// Set the gap (in microseconds, 0 for none) left after each command so that
+// the receiving device can keep up. Uses timer 2 and assumes an 8MHz clock.
+void spi_set_command_gap(uint8_t microseconds);
+
+// Turn slave select framing on (non-zero) or off. With framing on, SS is
+// taken high after the last byte of each command and low again before the
+// next command starts, so the receiving device can find the start of each
+// command even if a byte has been lost or corrupted. With it off, SS stays
+// low.
+void spi_set_command_framing(uint8_t on);
+
+// Choose the device (0 to SPI_NUM_DEVICES - 1) that bytes queued or sent
+// from now on go to. This must only be called between commands. Bytes
+// already queued still go to the device they were queued for.
+void spi_select_device(uint8_t device);
+
+// Wait until every queued byte has been sent.
+void spi_wait_until_idle(void);
+
+// Send and receive an SPI byte. Any queued bytes are sent first. This
+// function will take at least 8 cyles of the divided clock (i.e. will
+// busy wait).
 uint8_t spi_send_byte(uint8_t byte);
 
+// Queue statistics, for sizing SPI_QUEUE_SIZE
+void spi_get_queue_stats(SpiQueueStats* stats);
+void spi_reset_queue_stats(void);
+
 #endif /* SPI_H_ */
@@ -0,0 +1,123 @@
+/*
+ * sprite.c
+ *
+ * See sprite.h for details.
+ */
+
+#include "sprite.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#include "ledmatrix.h"
+
+static uint8_t asset_width(const SpriteAsset* asset) {
+	return (asset == NULL) ? 0 : pgm_read_byte(&asset->width);
+}
+
+// The pixels lit in column col of an asset whose bottom row is at y on the
+// display, as a bitmap of display rows. Pixels above or below the display
+// are dropped.
+static uint8_t column_bits(const SpriteAsset* asset, int16_t col, int8_t y) {
+	if (asset == NULL || col < 0 || col >= pgm_read_byte(&asset->width)) {
+		return 0;
+	}
+	const uint8_t* columns = pgm_read_ptr(&asset->columns);
+	uint8_t height = pgm_read_byte(&asset->height);
+	uint8_t bits = pgm_read_byte(&columns[col]);
+	if (height < 8) {
+		bits &= (1 << height) - 1;
+	}
+	if (y >= 0) {
+		return (y < MATRIX_NUM_ROWS) ? (uint8_t)(bits << y) : 0;
+	} else {
+		return (y > -MATRIX_NUM_ROWS) ? (bits >> -y) : 0;
+	}
+}
+
+void sprite_init(Sprite* sprite, const SpriteAsset* asset, int8_t x,
+		int8_t y, PaletteIndex colour) {
+	sprite->asset = asset;
+	sprite->x = x;
+	sprite->y = y;
+	sprite->colour = colour;
+	sprite->drawn_asset = NULL;
+	sprite->drawn_x = x;
+	sprite->drawn_y = y;
+	sprite->drawn_colour = colour;
+}
+
+void sprite_move(Sprite* sprite, int8_t x, int8_t y) {
+	sprite->x = x;
+	sprite->y = y;
+}
+
+void sprite_set_asset(Sprite* sprite, const SpriteAsset* asset) {
+	sprite->asset = asset;
+}
+
+void sprite_set_colour(Sprite* sprite, PaletteIndex colour) {
+	sprite->colour = colour;
+}
+
+void sprite_update(Sprite* sprite) {
+	if (sprite->asset == sprite->drawn_asset && sprite->x == sprite->drawn_x
+			&& sprite->y == sprite->drawn_y
+			&& sprite->colour == sprite->drawn_colour) {
+		return;
+	}
+
+	// Visit every display column covered by the old or new picture
+	int16_t left = sprite->x;
+	int16_t right = sprite->x + asset_width(sprite->asset);
+	if (sprite->drawn_asset != NULL) {
+		if (sprite->drawn_x < left) {
+			left = sprite->drawn_x;
+		}
+		if (sprite->drawn_x + asset_width(sprite->drawn_asset) > right) {
+			right = sprite->drawn_x + asset_width(sprite->drawn_asset);
+		}
+	}
+	if (left < 0) {
+		left = 0;
+	}
+	if (right > MATRIX_NUM_COLUMNS) {
+		right = MATRIX_NUM_COLUMNS;
+	}
+
+	// Pixels still lit in the same colour are left alone
+	uint8_t recolour = (sprite->colour != sprite->drawn_colour);
+	for (int16_t x = left; x < right; x++) {
+		uint8_t old_bits = column_bits(sprite->drawn_asset,
+				x - sprite->drawn_x, sprite->drawn_y);
+		uint8_t new_bits = column_bits(sprite->asset, x - sprite->x,
+				sprite->y);
+		ledmatrix_update_column_bits(x, 0, old_bits & ~new_bits,
+				PALETTE_BLACK);
+		ledmatrix_update_column_bits(x, 0,
+				recolour ? new_bits : (new_bits & ~old_bits), sprite->colour);
+	}
+
+	sprite->drawn_asset = sprite->asset;
+	sprite->drawn_x = sprite->x;
+	sprite->drawn_y = sprite->y;
+	sprite->drawn_colour = sprite->colour;
+}
+
+void sprite_blit(const SpriteAsset* asset, int8_t x, int8_t y,
+		PaletteIndex colour) {
+	int16_t right = x + asset_width(asset);
+	if (right > MATRIX_NUM_COLUMNS) {
+		right = MATRIX_NUM_COLUMNS;
+	}
+	for (int16_t col = (x < 0) ? 0 : x; col < right; col++) {
+		ledmatrix_update_column_bits(col, 0, column_bits(asset, col - x, y),
+				colour);
+	}
+}
+
+uint8_t sprite_asset_pixel(const SpriteAsset* asset, int8_t x, int8_t y) {
+	if (y < 0 || y >= MATRIX_NUM_ROWS) {
+		return 0;
+	}
+	return (column_bits(asset, x, 0) >> y) & 0x01;
+}
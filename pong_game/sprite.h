@@ -0,0 +1,71 @@
+/*
+ * sprite.h
+ *
+ * Single colour pictures (sprites) drawn onto the LED matrix, into the layer
+ * chosen by ledmatrix_draw_to().
+ *
+ * The picture for a sprite (a SpriteAsset) lives in flash. It is stored a
+ * column at a time from left to right, each column being a bitmap of the
+ * pixels that are lit in it with bit 0 the bottom row, so a sprite can be
+ * at most MATRIX_NUM_ROWS high. Unlit pixels are transparent.
+ *
+ * A Sprite places an asset on the display in a colour. It may be placed
+ * partly (or wholly) off the display - only the part on the display is
+ * drawn. Each Sprite remembers where and how it was last drawn, so
+ * sprite_update() only repaints the pixels it has moved out of (which are
+ * set to index 0 - black, or transparent on the HUD layer) or into.
+ */
+
+#ifndef SPRITE_H_
+#define SPRITE_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "ledmatrix.h"
+
+typedef struct {
+	uint8_t width;
+	uint8_t height;
+	const uint8_t* columns;		// width column bitmaps, also in flash
+} SpriteAsset;
+
+typedef struct {
+	// What the sprite should look like at the next sprite_update().
+	// asset points to flash. A NULL asset hides the sprite.
+	const SpriteAsset* asset;
+	int8_t x;		// position of the bottom left pixel
+	int8_t y;
+	PaletteIndex colour;
+
+	// What was drawn by the last sprite_update()
+	const SpriteAsset* drawn_asset;
+	int8_t drawn_x;
+	int8_t drawn_y;
+	PaletteIndex drawn_colour;
+} Sprite;
+
+// Set up a sprite which hasn't been drawn yet. Use this (rather than
+// sprite_update()) again after the display has been cleared by other means
+// so the sprite doesn't try to erase itself.
+void sprite_init(Sprite* sprite, const SpriteAsset* asset, int8_t x,
+		int8_t y, PaletteIndex colour);
+
+// Change how the sprite should look. Nothing is drawn until
+// sprite_update() is called.
+void sprite_move(Sprite* sprite, int8_t x, int8_t y);
+void sprite_set_asset(Sprite* sprite, const SpriteAsset* asset);
+void sprite_set_colour(Sprite* sprite, PaletteIndex colour);
+
+// Repaint the pixels of the sprite that have changed since it was last
+// drawn. Does nothing if the sprite hasn't changed.
+void sprite_update(Sprite* sprite);
+
+// Draw an asset at (x, y) without any tracking
+void sprite_blit(const SpriteAsset* asset, int8_t x, int8_t y,
+		PaletteIndex colour);
+
+// Returns 1 if pixel (x, y) of an asset (relative to its bottom left
+// pixel) is lit, 0 otherwise (including when it is outside the asset)
+uint8_t sprite_asset_pixel(const SpriteAsset* asset, int8_t x, int8_t y);
+
+#endif /* SPRITE_H_ */
@@ -0,0 +1,157 @@
+/*
+ * telemetry.c
+ *
+ * See telemetry.h for details.
+ */
+
+#include "telemetry.h"
+#include <stdint.h>
+#include <util/crc16.h>
+#include "game.h"
+#include "serialio.h"
+
+// The state as sent, and where each part of it starts (the last entry is
+// the end of the state)
+#define STATE_BYTES		(9)
+#define NUM_PARTS		(5)
+static const uint8_t PART_START[NUM_PARTS + 1] = {0, 2, 3, 5, 7, STATE_BYTES};
+
+// Longest packet: type, sequence number, time, state and check byte
+#define MAX_PACKET_BYTES	(2 + 4 + STATE_BYTES + 1)
+#if MAX_PACKET_BYTES > 253
+#error "Telemetry packets must be short enough to COBS encode in one block"
+#endif
+
+static uint8_t enabled = TELEMETRY_START_ENABLED;
+
+// The state and time of the last packet sent, its sequence number and
+// the number of packets since the last key packet. If send_key is set the
+// next packet is a key packet.
+static uint8_t sent_state[STATE_BYTES];
+static uint32_t sent_time;
+static uint8_t sequence;
+static uint8_t packets_since_key;
+static uint8_t send_key = 1;
+
+void telemetry_enable(uint8_t enable) {
+	enabled = enable;
+	send_key = 1;
+}
+
+uint8_t telemetry_enabled(void) {
+	return enabled;
+}
+
+static void read_state(uint8_t* state) {
+	GameState game;
+	get_game_state(&game);
+	state[0] = game.ball_x;
+	state[1] = game.ball_y;
+	state[2] = (game.ball_x_direction + 1) * 4 + game.ball_y_direction + 1;
+	state[3] = game.paddle_y[PLAYER_1];
+	state[4] = game.paddle_y[PLAYER_2];
+	state[5] = game.score[PLAYER_1];
+	state[6] = game.score[PLAYER_2];
+	state[7] = game.rally[PLAYER_1];
+	state[8] = game.rally[PLAYER_2];
+}
+
+// COBS encode length bytes of data into encoded, which needs room for
+// length + 1 bytes. Each zero is replaced by the distance to the next one
+// (or to the end), starting with the distance to the first. Returns the
+// length of the encoded data.
+static uint8_t cobs_encode(const uint8_t* data, uint8_t length,
+		uint8_t* encoded) {
+	uint8_t code_index = 0;
+	uint8_t encoded_length = 1;
+	uint8_t code = 1;
+	for (uint8_t i = 0; i < length; i++) {
+		if (data[i] == 0) {
+			encoded[code_index] = code;
+			code_index = encoded_length++;
+			code = 1;
+		} else {
+			encoded[encoded_length++] = data[i];
+			code++;
+		}
+	}
+	encoded[code_index] = code;
+	return encoded_length;
+}
+
+void telemetry_update(uint32_t time) {
+	if (!enabled) {
+		return;
+	}
+	uint8_t state[STATE_BYTES];
+	read_state(state);
+
+	uint8_t changed = 0;
+	for (uint8_t part = 0; part < NUM_PARTS; part++) {
+		for (uint8_t i = PART_START[part]; i < PART_START[part + 1]; i++) {
+			if (state[i] != sent_state[i]) {
+				changed |= 1 << part;
+			}
+		}
+	}
+	uint32_t elapsed = time - sent_time;
+	uint8_t key = send_key || packets_since_key >= TELEMETRY_KEY_INTERVAL
+			|| elapsed > 255;
+	if (!key && !changed && elapsed < TELEMETRY_IDLE_MS) {
+		return;
+	}
+
+	uint8_t packet[MAX_PACKET_BYTES];
+	uint8_t length = 0;
+	packet[length++] = key ? TELEMETRY_KEY : TELEMETRY_DELTA;
+	packet[length++] = sequence;
+	if (key) {
+		for (uint8_t i = 0; i < 4; i++) {
+			packet[length++] = time >> (8 * i);
+		}
+		for (uint8_t i = 0; i < STATE_BYTES; i++) {
+			packet[length++] = state[i];
+		}
+	} else {
+		packet[length++] = elapsed;
+		packet[length++] = changed;
+		for (uint8_t part = 0; part < NUM_PARTS; part++) {
+			if (changed & (1 << part)) {
+				for (uint8_t i = PART_START[part]; i < PART_START[part + 1];
+						i++) {
+					packet[length++] = state[i];
+				}
+			}
+		}
+	}
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < length; i++) {
+		crc = _crc8_ccitt_update(crc, packet[i]);
+	}
+	packet[length++] = crc;
+
+	// Encode the packet between the zeros that mark its ends
+	uint8_t frame[MAX_PACKET_BYTES + 3];
+	frame[0] = 0;
+	uint8_t frame_length = 1 + cobs_encode(packet, length, &frame[1]);
+	frame[frame_length++] = 0;
+	// Telemetry is debug output, which never holds up the game
+	SerialClass previous_class = serial_set_class(SERIAL_DEBUG);
+	uint8_t space = serial_output_space();
+	if (frame_length <= space) {
+		serial_put_bytes(frame, frame_length);
+	}
+	serial_set_class(previous_class);
+	if (frame_length > space) {
+		// Try again next frame
+		return;
+	}
+
+	for (uint8_t i = 0; i < STATE_BYTES; i++) {
+		sent_state[i] = state[i];
+	}
+	sent_time = time;
+	sequence++;
+	packets_since_key = key ? 0 : packets_since_key + 1;
+	send_key = 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * telemetry.h
+ *
+ * An optional binary stream of the game state over the serial port, for
+ * host tools to record and replay matches at the full frame rate.
+ *
+ * Each packet is COBS encoded (so it has no zero bytes in it) and has a
+ * zero byte before and after it. Any text written to the terminal between
+ * packets never has a zero in it either, so a host can split what it
+ * receives at the zeros and keep just the parts that decode to a packet
+ * with a good check byte. All multi-byte numbers are little endian.
+ *
+ * Before encoding a packet is a type byte, a sequence number (one more
+ * than the last packet's, wrapping at 256), the packet's data and a CRC-8
+ * (polynomial 0x07, starting from 0) of everything before it. There are
+ * two types:
+ *   TELEMETRY_KEY    the time (4 bytes, from get_current_time()) and the
+ *                    whole state
+ *   TELEMETRY_DELTA  the ms since the last packet (1 byte), a byte with a
+ *                    bit set for each part of the state that has changed
+ *                    since the last packet, then those parts in order
+ * The state is in parts of one or two bytes (see TELEMETRY_PART_*):
+ *   ball x and y, ball directions ((x + 1) * 4 + y + 1), the paddles' y,
+ *   the scores and the rally counts, each player 1 then player 2.
+ *
+ * Packets are only sent when the state changes, or every
+ * TELEMETRY_IDLE_MS so a host knows the game is still running. Every
+ * TELEMETRY_KEY_INTERVAL packets is a key packet, so a host that has
+ * missed a packet (seen from a gap in the sequence numbers) can start
+ * again. A packet is never sent unless there is room for it in the serial
+ * output buffer, so telemetry never holds up the game - the changes are
+ * sent in the next packet instead.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+// Packet types
+#define TELEMETRY_KEY		(1)
+#define TELEMETRY_DELTA		(2)
+
+// Bits of the changed byte in a delta packet
+#define TELEMETRY_PART_BALL			(1 << 0)
+#define TELEMETRY_PART_DIRECTION	(1 << 1)
+#define TELEMETRY_PART_PADDLES		(1 << 2)
+#define TELEMETRY_PART_SCORES		(1 << 3)
+#define TELEMETRY_PART_RALLIES		(1 << 4)
+
+// Longest time without a packet while the game is running, and the
+// number of packets from one key packet to the next
+#define TELEMETRY_IDLE_MS			(200)
+#define TELEMETRY_KEY_INTERVAL		(50)
+
+// Whether telemetry is on from start up
+#ifndef TELEMETRY_START_ENABLED
+#define TELEMETRY_START_ENABLED		(0)
+#endif
+
+// Turn telemetry on (1) or off (0). The first packet after turning it on
+// is a key packet.
+void telemetry_enable(uint8_t enable);
+uint8_t telemetry_enabled(void);
+
+// Send a packet if one is due (see above), with time as the current time.
+// Call this once per frame.
+void telemetry_update(uint32_t time);
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,166 @@
+/*
+ * terminal_board.c
+ *
+ * See terminal_board.h for details.
+ */
+
+#include "terminal_board.h"
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "game.h"
+#include "serialio.h"
+#include "terminalio.h"
+
+// What a cell shows, and the background colour it is drawn in
+#define CELL_EMPTY		(0)
+#define CELL_BORDER		(1)
+#define CELL_PADDLE		(2)
+#define CELL_BALL		(3)
+#define CELL_RALLY		(4)
+#define CELL_UNKNOWN	(0x0F)
+static const uint8_t CELL_BACKGROUND[] PROGMEM = {
+	BG_BLACK, BG_YELLOW, BG_GREEN, BG_RED, BG_MAGENTA
+};
+
+// The cells are numbered along each row from the top row down. What the
+// terminal shows for each is kept in 4 bits.
+#define NUM_COLUMNS		(BOARD_LAYOUT_WIDTH)
+#define NUM_ROWS		(MATRIX_NUM_ROWS)
+#define NUM_CELLS		(NUM_COLUMNS * NUM_ROWS)
+#if NUM_CELLS > 255
+#error "The terminal board has too many cells"
+#endif
+static uint8_t shown[(NUM_CELLS + 1) / 2];
+
+// Bytes in an escape sequence setting the background colour, and in one
+// setting the attributes back to normal
+#define BACKGROUND_BYTES	(5)
+#define NORMAL_BYTES		(4)
+
+// The game state when the terminal was last brought up to date (valid if
+// up_to_date is set), and the cell the next update starts from
+static GameState drawn_state;
+static uint8_t up_to_date;
+static uint8_t next_cell;
+
+static uint8_t shown_cell(uint8_t cell) {
+	uint8_t pair = shown[cell / 2];
+	return (cell & 1) ? pair >> 4 : pair & 0x0F;
+}
+
+static void set_shown_cell(uint8_t cell, uint8_t contents) {
+	uint8_t* pair = &shown[cell / 2];
+	if (cell & 1) {
+		*pair = (*pair & 0x0F) | (contents << 4);
+	} else {
+		*pair = (*pair & 0xF0) | contents;
+	}
+}
+
+void term_board_init(void) {
+	memset(shown, (CELL_UNKNOWN << 4) | CELL_UNKNOWN, sizeof(shown));
+	up_to_date = 0;
+	next_cell = 0;
+}
+
+// What the cell in column x of the layout and row y of the matrix (from
+// the bottom) should show
+static uint8_t cell_contents(const GameState* state, uint8_t x, uint8_t y) {
+	if (x == 0) {
+		return (y < state->rally[PLAYER_1]) ? CELL_RALLY : CELL_EMPTY;
+	}
+	if (x == NUM_COLUMNS - 1) {
+		return (y < state->rally[PLAYER_2]) ? CELL_RALLY : CELL_EMPTY;
+	}
+	int8_t board_x = x - (RALLY_METER_WIDTH + GAME_BORDER_WIDTH);
+	int8_t board_y = y - MATRIX_Y_OFFSET;
+	if (board_x < 0 || board_x >= BOARD_WIDTH) {
+		return CELL_BORDER;
+	}
+	if (board_y < 0 || board_y >= BOARD_HEIGHT) {
+		return CELL_EMPTY;
+	}
+	if (board_x == state->ball_x && board_y == state->ball_y) {
+		return CELL_BALL;
+	}
+	for (uint8_t player = PLAYER_1; player <= PLAYER_2; player++) {
+		if (board_x == ((player == PLAYER_1) ? PLAYER_1_X : PLAYER_2_X)
+				&& board_y >= state->paddle_y[player]
+				&& board_y < state->paddle_y[player] + PLAYER_HEIGHT) {
+			return CELL_PADDLE;
+		}
+	}
+	return CELL_EMPTY;
+}
+
+void term_board_update(void) {
+	GameState state;
+	get_game_state(&state);
+	if (up_to_date && memcmp(&state, &drawn_state, sizeof(state)) == 0) {
+		return;
+	}
+	// The board is sent as a normal message (see terminalio.h for why the
+	// cursor is forgotten)
+	SerialClass previous_class = serial_set_class(SERIAL_NORMAL);
+	terminal_cursor_at(0, 0);
+	uint8_t budget = serial_output_space();
+	if (budget > TERM_BOARD_UPDATE_BYTES) {
+		budget = TERM_BOARD_UPDATE_BYTES;
+	}
+	if (budget <= NORMAL_BYTES) {
+		serial_set_class(previous_class);
+		return;
+	}
+	// Leave room to set the attributes back to normal at the end
+	budget -= NORMAL_BYTES;
+
+	// The background colour we have set (0 if we haven't)
+	uint8_t background = 0;
+	uint8_t cell = next_cell;
+	uint8_t x = cell % NUM_COLUMNS;
+	uint8_t row = cell / NUM_COLUMNS;
+	up_to_date = 1;
+	for (uint8_t i = 0; i < NUM_CELLS; i++) {
+		uint8_t contents = cell_contents(&state, x, NUM_ROWS - 1 - row);
+		if (contents != shown_cell(cell)) {
+			uint8_t want_background =
+					pgm_read_byte(&CELL_BACKGROUND[contents]);
+			uint8_t terminal_x = TERM_BOARD_X + 2 * x;
+			uint8_t terminal_y = TERM_BOARD_Y + row;
+			uint8_t cost = terminal_cursor_move_bytes(terminal_x, terminal_y) + 2
+					+ ((want_background != background) ? BACKGROUND_BYTES : 0);
+			if (cost > budget) {
+				// The rest waits for the next update
+				up_to_date = 0;
+				break;
+			}
+			budget -= cost;
+			move_terminal_cursor_shortest(terminal_x, terminal_y);
+			if (want_background != background) {
+				set_display_attribute(want_background);
+				background = want_background;
+			}
+			serial_put_char(' ');
+			serial_put_char(' ');
+			terminal_cursor_at(terminal_x + 2, terminal_y);
+			set_shown_cell(cell, contents);
+		}
+		cell++;
+		x++;
+		if (x == NUM_COLUMNS) {
+			x = 0;
+			row++;
+			if (cell == NUM_CELLS) {
+				cell = 0;
+				row = 0;
+			}
+		}
+	}
+	next_cell = cell;
+	if (background != 0) {
+		normal_display_mode();
+	}
+	drawn_state = state;
+	serial_set_class(previous_class);
+}
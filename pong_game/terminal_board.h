@@ -0,0 +1,39 @@
+/*
+ * terminal_board.h
+ *
+ * A copy of the game board on the serial terminal: the rally meters,
+ * borders, paddles and ball laid out as on the LED matrix (see
+ * board_config.h), each matrix pixel drawn as two spaces with a coloured
+ * background.
+ *
+ * Only cells that differ from what the terminal shows are drawn, so after
+ * the first paint a ball move costs a couple of cells. Each update sends at
+ * most TERM_BOARD_UPDATE_BYTES (and never more than there is room for in
+ * the serial output buffer), carrying on next update from where it
+ * stopped, so the board never holds up the game - even the first paint is
+ * spread over several updates.
+ */
+
+#ifndef TERMINAL_BOARD_H_
+#define TERMINAL_BOARD_H_
+
+#include <stdint.h>
+
+// Terminal column and row of the top left of the board
+#define TERM_BOARD_X	(10)
+#define TERM_BOARD_Y	(22)
+
+// Most bytes term_board_update() sends at a time
+#ifndef TERM_BOARD_UPDATE_BYTES
+#define TERM_BOARD_UPDATE_BYTES		(32)
+#endif
+
+// Forget what the terminal shows, so the whole board is drawn again. Call
+// this after clearing the terminal.
+void term_board_init(void);
+
+// Send the changes to the board since the last update (see above). Call it
+// once per tick.
+void term_board_update(void);
+
+#endif /* TERMINAL_BOARD_H_ */
@@ -0,0 +1,152 @@
+/*
+ * terminal_screen.c
+ *
+ * See terminal_screen.h for details.
+ */
+
+#include "terminal_screen.h"
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "terminalio.h"
+#include "serialio.h"
+
+// Each field's characters are in wanted (what it should show) and shown
+// (what the terminal is showing), from index first
+typedef struct {
+	uint8_t x;
+	uint8_t y;
+	uint8_t width;
+	uint8_t first;
+} Field;
+
+static Field fields[TERM_SCREEN_MAX_FIELDS];
+static uint8_t num_fields;
+static uint8_t chars_used;
+static char wanted[TERM_SCREEN_MAX_CHARS];
+static char shown[TERM_SCREEN_MAX_CHARS];
+
+void term_screen_clear(void) {
+	clear_terminal();
+	num_fields = 0;
+	chars_used = 0;
+}
+
+TermField term_screen_add_field(uint8_t x, uint8_t y, uint8_t width) {
+	if (num_fields == TERM_SCREEN_MAX_FIELDS || x == 0 || y == 0
+			|| width > TERM_SCREEN_MAX_CHARS - chars_used
+			|| x + width - 1 > TERM_SCREEN_COLUMNS) {
+		return TERM_FIELD_NONE;
+	}
+	Field* field = &fields[num_fields];
+	field->x = x;
+	field->y = y;
+	field->width = width;
+	field->first = chars_used;
+	for (uint8_t i = 0; i < width; i++) {
+		wanted[chars_used + i] = ' ';
+		shown[chars_used + i] = ' ';
+	}
+	chars_used += width;
+	return num_fields++;
+}
+
+void term_screen_set_text_P(TermField field, const char* text) {
+	if (field >= num_fields) {
+		return;
+	}
+	uint8_t width = fields[field].width;
+	char* want = &wanted[fields[field].first];
+
+	// Control characters would upset our idea of where the cursor is, so
+	// they are shown as spaces
+	uint8_t i = 0;
+	char c;
+	for (; i < width && (c = pgm_read_byte(&text[i])) != '\0'; i++) {
+		want[i] = (c < ' ') ? ' ' : c;
+	}
+	for (; i < width; i++) {
+		want[i] = ' ';
+	}
+}
+
+void term_screen_set_uint(TermField field, uint16_t value) {
+	if (field >= num_fields) {
+		return;
+	}
+	uint8_t width = fields[field].width;
+	char* want = &wanted[fields[field].first];
+	char digits[5];
+	uint8_t length = serial_format_uint(value, digits);
+	for (uint8_t i = 0; i < width; i++) {
+		want[i] = (i < length) ? digits[i] : ' ';
+	}
+}
+
+void term_screen_update(void) {
+	// The fields are sent as a critical message (see terminalio.h for why
+	// the cursor is forgotten)
+	SerialClass previous_class = serial_set_class(SERIAL_CRITICAL);
+	terminal_cursor_at(0, 0);
+	uint8_t budget = serial_output_space();
+	if (budget > TERM_SCREEN_UPDATE_BYTES) {
+		budget = TERM_SCREEN_UPDATE_BYTES;
+	}
+
+	for (uint8_t i = 0; i < num_fields; i++) {
+		Field* field = &fields[i];
+		char* want = &wanted[field->first];
+		char* show = &shown[field->first];
+		uint8_t start = 0;
+		while (start < field->width) {
+			if (want[start] == show[start]) {
+				start++;
+				continue;
+			}
+			// Send a run of changed characters, taking in any gaps of
+			// unchanged ones that are cheaper to resend than to move past
+			uint8_t end = start + 1;
+			for (uint8_t j = end; j < field->width; j++) {
+				if (want[j] != show[j]) {
+					if (j - end > terminal_cursor_step_bytes(j - end)) {
+						break;
+					}
+					end = j + 1;
+				}
+			}
+			uint8_t move = terminal_cursor_move_bytes(field->x + start,
+					field->y);
+			if (move >= budget) {
+				// The rest waits for a later update
+				goto done;
+			}
+			if (move + (end - start) > budget) {
+				// Send as much of the run as fits
+				end = start + (budget - move);
+			}
+			move_terminal_cursor_shortest(field->x + start, field->y);
+			budget -= move + (end - start);
+			for (; start < end; start++) {
+				serial_put_char(want[start]);
+				show[start] = want[start];
+			}
+			if (field->x + end > TERM_SCREEN_COLUMNS) {
+				// The terminal may or may not have wrapped to the next row
+				terminal_cursor_at(0, 0);
+			} else {
+				terminal_cursor_at(field->x + end, field->y);
+			}
+		}
+	}
+
+done:
+	serial_set_class(previous_class);
+}
+
+uint8_t term_screen_up_to_date(void) {
+	for (uint8_t i = 0; i < chars_used; i++) {
+		if (wanted[i] != shown[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
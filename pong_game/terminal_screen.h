@@ -0,0 +1,67 @@
+/*
+ * terminal_screen.h
+ *
+ * Keeps the changing text on the serial terminal up to date without
+ * resending it all. The text is held in fields - runs of characters at a
+ * fixed position on one row of the terminal. Setting a field's text
+ * changes only what we want it to show; term_screen_update() then sends
+ * just the characters that differ from what the terminal is showing, with
+ * the shortest cursor movement to reach each run of them (none when the
+ * cursor is already there, a relative move when that is shorter than an
+ * absolute one).
+ *
+ * The changes are sent as critical serial output (see serialio.h), so they
+ * never wait behind other output. term_screen_update() never writes more
+ * than there is room for in the critical output buffer, so it never waits
+ * for the UART either.
+ * Changes that don't fit are sent by a later update. Call it once per tick
+ * from the main loop, so each tick's changes go out together.
+ *
+ * Anything else may still be written to the terminal (e.g. text that is
+ * printed once and never changes) as long as it doesn't overwrite a field.
+ * The cursor position is assumed unknown at the start of each update.
+ */
+
+#ifndef TERMINAL_SCREEN_H_
+#define TERMINAL_SCREEN_H_
+
+#include <stdint.h>
+
+// Room for the fields: the number of fields, and the number of characters
+// across all of them
+#define TERM_SCREEN_MAX_FIELDS	(10)
+#define TERM_SCREEN_MAX_CHARS	(96)
+
+// Width of the terminal. Fields must not run past the last column.
+#define TERM_SCREEN_COLUMNS		(80)
+
+// Most bytes term_screen_update() sends at a time - about what the UART
+// sends in a 20ms tick at 19200 baud
+#define TERM_SCREEN_UPDATE_BYTES	(40)
+
+typedef uint8_t TermField;
+#define TERM_FIELD_NONE		(0xFF)
+
+// Clear the terminal and remove all the fields
+void term_screen_clear(void);
+
+// Add a field of width characters starting at column x of row y (both
+// from 1, as for move_terminal_cursor()). The field starts blank, and the
+// terminal is assumed to be blank there too, so fields should be added
+// just after term_screen_clear(). Returns TERM_FIELD_NONE if there is no
+// room for it. Setting its text does nothing in that case.
+TermField term_screen_add_field(uint8_t x, uint8_t y, uint8_t width);
+
+// Set the text a field should show: a string in flash (e.g. from PSTR()),
+// or a number in decimal. The text is cut off at the width of the field,
+// or padded with spaces to it.
+void term_screen_set_text_P(TermField field, const char* text);
+void term_screen_set_uint(TermField field, uint16_t value);
+
+// Send changes to the terminal (see above)
+void term_screen_update(void);
+
+// Returns 1 if every field shows what it should, 0 otherwise.
+uint8_t term_screen_up_to_date(void);
+
+#endif /* TERMINAL_SCREEN_H_ */
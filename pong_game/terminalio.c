@@ -5,67 +5,185 @@
  */
 
 #include "terminalio.h"
-#include <stdio.h>
 #include <stdint.h>
 #include <avr/pgmspace.h>
+#include "serialio.h"
 
+// The escape sequences are written straight to the serial port from flash,
+// with any numbers in them written by serial_put_uint(), rather than being
+// formatted by printf.
 
 void move_terminal_cursor(int x, int y) {
-    printf_P(PSTR("\x1b[%d;%dH"), y, x);
+	serial_put_string_P(PSTR("\x1b["));
+	serial_put_uint(y);
+	serial_put_char(';');
+	serial_put_uint(x);
+	serial_put_char('H');
+}
+
+// ESC [ n and the direction letter. The count is left out when it is 1.
+static void move_cursor_by(uint8_t n, char direction) {
+	if (n == 0) {
+		return;
+	}
+	serial_put_string_P(PSTR("\x1b["));
+	if (n > 1) {
+		serial_put_uint(n);
+	}
+	serial_put_char(direction);
+}
+
+void move_terminal_cursor_up(uint8_t n) {
+	move_cursor_by(n, 'A');
+}
+
+void move_terminal_cursor_down(uint8_t n) {
+	move_cursor_by(n, 'B');
+}
+
+void move_terminal_cursor_right(uint8_t n) {
+	move_cursor_by(n, 'C');
+}
+
+void move_terminal_cursor_left(uint8_t n) {
+	move_cursor_by(n, 'D');
 }
 
 void normal_display_mode(void) {
-	printf_P(PSTR("\x1b[0m"));
+	serial_put_string_P(PSTR("\x1b[0m"));
 }
 
 void reverse_video(void) {
-	printf_P(PSTR("\x1b[7m"));
+	serial_put_string_P(PSTR("\x1b[7m"));
 }
 
 void clear_terminal(void) {
-	printf_P(PSTR("\x1b[2J"));
+	serial_put_string_P(PSTR("\x1b[2J"));
 }
 
 void clear_to_end_of_line(void) {
-	printf_P(PSTR("\x1b[K"));
+	serial_put_string_P(PSTR("\x1b[K"));
 }
 
 void set_display_attribute(DisplayParameter parameter) {
-	printf_P(PSTR("\x1b[%dm"), parameter);
+	serial_put_string_P(PSTR("\x1b["));
+	serial_put_uint(parameter);
+	serial_put_char('m');
 }
 
 void hide_cursor() {
-	printf_P(PSTR("\x1b[?25l"));
+	serial_put_string_P(PSTR("\x1b[?25l"));
 }
 
 void show_cursor() {
-	printf_P(PSTR("\x1b[?25h"));
+	serial_put_string_P(PSTR("\x1b[?25h"));
+}
+
+// Where the terminal cursor is (cursor_x is 0 if we don't know)
+static uint8_t cursor_x;
+static uint8_t cursor_y;
+
+void terminal_cursor_at(uint8_t x, uint8_t y) {
+	cursor_x = x;
+	cursor_y = y;
+}
+
+// Number of decimal digits in n
+static uint8_t digits(uint8_t n) {
+	return (n >= 100) ? 3 : (n >= 10) ? 2 : 1;
+}
+
+// ESC [ n and a letter, where n is left out if it is 1
+uint8_t terminal_cursor_step_bytes(uint8_t n) {
+	if (n == 0) {
+		return 0;
+	}
+	return (n == 1) ? 3 : 3 + digits(n);
+}
+
+// Bytes needed to move the cursor across a row to column x: none if it is
+// there, a carriage return to the first column, a backspace to go back
+// one column, otherwise an escape sequence
+static uint8_t horizontal_move_bytes(uint8_t x) {
+	if (x == cursor_x) {
+		return 0;
+	}
+	if (x == 1 || x == cursor_x - 1) {
+		return 1;
+	}
+	return terminal_cursor_step_bytes((x > cursor_x) ? x - cursor_x
+			: cursor_x - x);
+}
+
+static uint8_t absolute_move_bytes(uint8_t x, uint8_t y) {
+	return 4 + digits(y) + digits(x);	// ESC [ y ; x H
+}
+
+static uint8_t relative_moves_bytes(uint8_t x, uint8_t y) {
+	return terminal_cursor_step_bytes((y > cursor_y) ? y - cursor_y
+			: cursor_y - y) + horizontal_move_bytes(x);
+}
+
+uint8_t terminal_cursor_move_bytes(uint8_t x, uint8_t y) {
+	uint8_t absolute = absolute_move_bytes(x, y);
+	if (cursor_x == 0) {
+		return absolute;
+	}
+	uint8_t relative = relative_moves_bytes(x, y);
+	return (relative < absolute) ? relative : absolute;
+}
+
+void move_terminal_cursor_shortest(uint8_t x, uint8_t y) {
+	if (cursor_x == 0
+			|| absolute_move_bytes(x, y) <= relative_moves_bytes(x, y)) {
+		move_terminal_cursor(x, y);
+	} else {
+		if (y > cursor_y) {
+			move_terminal_cursor_down(y - cursor_y);
+		} else {
+			move_terminal_cursor_up(cursor_y - y);
+		}
+		if (x == cursor_x) {
+			// Already in the right column
+		} else if (x == 1) {
+			serial_put_char('\r');
+		} else if (x == cursor_x - 1) {
+			serial_put_char('\b');
+		} else if (x > cursor_x) {
+			move_terminal_cursor_right(x - cursor_x);
+		} else {
+			move_terminal_cursor_left(cursor_x - x);
+		}
+	}
+	cursor_x = x;
+	cursor_y = y;
 }
 
 void enable_scrolling_for_whole_display(void) {
-	printf_P(PSTR("\x1b[r"));
+	serial_put_string_P(PSTR("\x1b[r"));
 }
 
 void set_scroll_region(int8_t y1, int8_t y2) {
-	printf_P(PSTR("\x1b[%d;%dr"), y1, y2);
+	serial_put_string_P(PSTR("\x1b["));
+	serial_put_uint(y1);
+	serial_put_char(';');
+	serial_put_uint(y2);
+	serial_put_char('r');
 }
 
 void scroll_down(void) {
-	printf_P(PSTR("\x1bM"));	// ESC-M
+	serial_put_string_P(PSTR("\x1bM"));	// ESC-M
 }
 
 void scroll_up(void) {
-	printf_P(PSTR("\x1b\x44"));	// ESC-D
+	serial_put_string_P(PSTR("\x1b\x44"));	// ESC-D
 }
 
 void draw_horizontal_line(int8_t y, int8_t start_x, int8_t end_x) {
 	move_terminal_cursor(start_x, y);
 	reverse_video();
 	for (int8_t i = start_x; i <= end_x; i++) {
-		printf(" ");	/* No need to use printf_P - printing 
-						 * a single character gets optimised
-						 * to a putchar call 
-						 */
+		serial_put_char(' ');
 	}
 	normal_display_mode();
 }
@@ -74,10 +192,10 @@ void draw_vertical_line(int8_t x, int8_t start_y, int8_t end_y) {
 	move_terminal_cursor(x, start_y);
 	reverse_video();
 	for(int8_t i = start_y; i < end_y; i++) {
-		printf(" ");
+		serial_put_char(' ');
 		/* Move down one and back to the left one */
-		printf_P(PSTR("\x1b[B\x1b[D"));
+		serial_put_string_P(PSTR("\x1b[B\x1b[D"));
 	}
-	printf(" ");
+	serial_put_char(' ');
 	normal_display_mode();
 }
@@ -55,6 +55,11 @@ typedef enum {
 } DisplayParameter;
 
 void move_terminal_cursor(int x, int y);
+// Move the cursor n places from where it is (nothing is sent if n is 0)
+void move_terminal_cursor_up(uint8_t n);
+void move_terminal_cursor_down(uint8_t n);
+void move_terminal_cursor_right(uint8_t n);
+void move_terminal_cursor_left(uint8_t n);
 void normal_display_mode(void);
 void reverse_video(void);
 void clear_terminal(void);
@@ -63,6 +68,21 @@ void set_display_attribute(DisplayParameter parameter);
 void hide_cursor(void);
 void show_cursor(void);
 
+// Moving the cursor in as few bytes as possible. These keep track of where
+// the cursor is, so a message can move it relative to where it was left.
+// Other output may have been sent since, so a message should start with
+// terminal_cursor_at(0, 0) - for "we don't know" - which makes the first
+// move an absolute one. After writing characters, tell them where the
+// cursor has ended up with terminal_cursor_at().
+void terminal_cursor_at(uint8_t x, uint8_t y);
+// Bytes needed to move the cursor n places in one direction
+uint8_t terminal_cursor_step_bytes(uint8_t n);
+// Bytes needed to move the cursor to (x, y), and the move itself - the
+// shortest of an absolute move and relative moves (including a carriage
+// return or backspace)
+uint8_t terminal_cursor_move_bytes(uint8_t x, uint8_t y);
+void move_terminal_cursor_shortest(uint8_t x, uint8_t y);
+
 // Enable scrolling for either the full screen or a particular region (rows)
 // For set_scroll_region y1 < y2 and the region includes rows y1 and y2.
 void enable_scrolling_for_whole_display(void);
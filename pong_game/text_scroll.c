@@ -0,0 +1,86 @@
+/*
+ * text_scroll.c
+ *
+ * See text_scroll.h for details.
+ */
+
+#include "text_scroll.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#include "ledmatrix.h"
+#include "font.h"
+
+// The next character to draw (in flash) - NULL when no text is scrolling -
+// and the column of it to draw next. Columns past the glyph's width are
+// the spacing before the next character.
+static const char* scroll_char;
+static uint8_t scroll_column;
+
+// Blank columns still to shift in after the end of the text, to carry it
+// off the display
+static uint8_t trailing_columns;
+
+static PaletteIndex scroll_colour;
+static uint16_t scroll_step_time;
+static uint32_t last_step_time;
+
+void text_scroll_start(const char* text, PaletteIndex colour,
+		uint16_t step_time, uint32_t current_time) {
+	scroll_char = text;
+	scroll_column = 0;
+	trailing_columns = MATRIX_NUM_COLUMNS;
+	scroll_colour = colour;
+	scroll_step_time = step_time;
+	// Make the first step due straight away
+	last_step_time = current_time - step_time;
+}
+
+uint8_t text_scroll_running(void) {
+	return scroll_char != NULL;
+}
+
+void text_scroll_stop(void) {
+	scroll_char = NULL;
+}
+
+// Returns the bitmap of the next column of the text and moves on past it.
+// Returns 0 (a blank column) once the text has run out.
+static uint8_t next_column(void) {
+	char c = pgm_read_byte(scroll_char);
+	if (c == '\0') {
+		trailing_columns--;
+		return 0;
+	}
+	uint8_t bits = font_glyph_column(c, scroll_column);
+	scroll_column++;
+	if (scroll_column >= font_glyph_width(c) + FONT_GLYPH_SPACING) {
+		scroll_char++;
+		scroll_column = 0;
+	}
+	return bits;
+}
+
+void text_scroll_update(uint32_t current_time) {
+	if (scroll_char == NULL
+			|| current_time - last_step_time < scroll_step_time) {
+		return;
+	}
+	last_step_time = current_time;
+
+	uint8_t bits = next_column();
+	MatrixColumn column;
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		if (y >= TEXT_SCROLL_Y && ((bits >> (y - TEXT_SCROLL_Y)) & 0x01)) {
+			column[y] = scroll_colour;
+		} else {
+			column[y] = PALETTE_BLACK;
+		}
+	}
+	ledmatrix_shift_display_left();
+	ledmatrix_update_column(MATRIX_NUM_COLUMNS - 1, column);
+
+	if (trailing_columns == 0) {
+		scroll_char = NULL;
+	}
+}
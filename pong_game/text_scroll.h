@@ -0,0 +1,44 @@
+/*
+ * text_scroll.h
+ *
+ * Scrolls a line of text (in the font from font.h) across the LED matrix
+ * from right to left. Each step shifts the display one column to the left
+ * with the matrix's shift command and draws the next column of the text
+ * in the rightmost column, so a step costs the shift command plus one
+ * column however long the text is.
+ *
+ * The text scrolls in the background: start it with text_scroll_start()
+ * and call text_scroll_update() from the main loop until
+ * text_scroll_running() returns 0, which is once the text has scrolled off
+ * the left of the display. Shifting moves everything on the display (on
+ * every layer), so nothing else should draw to the display while text is
+ * scrolling.
+ */
+
+#ifndef TEXT_SCROLL_H_
+#define TEXT_SCROLL_H_
+
+#include <stdint.h>
+#include "ledmatrix.h"
+
+// Default time between scroll steps in milliseconds
+#define TEXT_SCROLL_STEP_MS	(60)
+
+// Row of the display that the bottom of the text is drawn on
+#define TEXT_SCROLL_Y	(2)
+
+// Start scrolling text (a string in flash, e.g. from PSTR()) in the given
+// colour, one column every step_time milliseconds. The rest of each column
+// is drawn black. Any text already scrolling is abandoned where it is.
+void text_scroll_start(const char* text, PaletteIndex colour,
+		uint16_t step_time, uint32_t current_time);
+
+// Carry out the next scroll step if it is due
+void text_scroll_update(uint32_t current_time);
+
+// Returns 1 if text is still scrolling, 0 otherwise.
+uint8_t text_scroll_running(void);
+
+void text_scroll_stop(void);
+
+#endif /* TEXT_SCROLL_H_ */
@@ -19,6 +19,12 @@
  * millisecond. Will overflow every ~49 days. */
 static volatile uint32_t clock_ticks_ms;
 
+/* Frame timing for the LED matrix display. frame_ticks_ms counts up to
+ * FRAME_PERIOD_MS and then sets frame_pending, which is cleared when
+ * frame_due() reports it. */
+static volatile uint8_t frame_ticks_ms;
+static volatile uint8_t frame_pending;
+
 /* Set up timer 0 to generate an interrupt every 1ms. 
  * We will divide the clock by 64 and count up to 124.
  * We will therefore get an interrupt every 64 x 125
@@ -32,6 +38,8 @@ void init_timer0(void) {
 	 * constant. 
 	 */
 	clock_ticks_ms = 0L;
+	frame_ticks_ms = 0;
+	frame_pending = 0;
 	
 	/* Clear the timer */
 	TCNT0 = 0;
@@ -75,9 +83,25 @@ uint32_t get_current_time(void) {
 	return return_value;
 }
 
+uint8_t frame_due(void) {
+	/* A single byte is read and written atomically, so we don't need
+	 * to disable interrupts here. */
+	if (frame_pending) {
+		frame_pending = 0;
+		return 1;
+	}
+	return 0;
+}
+
 ISR(TIMER0_COMPA_vect) {
 	/* Increment our clock tick count */
 	clock_ticks_ms++;
+
+	/* Start a new display frame every FRAME_PERIOD_MS */
+	if (++frame_ticks_ms >= FRAME_PERIOD_MS) {
+		frame_ticks_ms = 0;
+		frame_pending = 1;
+	}
 	
 	// ssd
 	seven_seg_dis();
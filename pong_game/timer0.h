@@ -30,4 +30,13 @@ void init_timer0(void);
  */
 uint32_t get_current_time(void);
 
+/* Period (in milliseconds) of the display frame tick. Display changes are
+ * committed to the LED matrix once per frame.
+ */
+#define FRAME_PERIOD_MS 20
+
+/* Return 1 if a frame tick has occurred since the last call, 0 otherwise.
+ */
+uint8_t frame_due(void);
+
 #endif /* TIMER0_H_ */
@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+#
+# animc.py
+#
+# Animation compiler. Turns text descriptions of LED matrix animations
+# (assets/*.anim) into compressed streams in flash which are played by
+# anim_stream.c. Run by the pre-build step in ass2.cproj:
+#
+#     python tools/animc.py -o . assets/*.anim
+#
+# which (re)writes anim_data.c and anim_data.h. The files are only written
+# when their contents change, so the firmware isn't rebuilt needlessly.
+# Wildcards in the file names are expanded here, as the Windows command
+# line leaves them to the program, so an asset dropped into assets/ is
+# picked up without changing the build step.
+#
+# An .anim file holds the following lines. Blank lines and lines starting
+# with # are ignored.
+#
+#     name <identifier>          the stream is called <identifier>_anim
+#     columns <first> <count>    the matrix columns the animation draws
+#     frame_time <ms>            time each frame is shown for
+#     colour <char> <value>      a pixel character and the palette index it
+#                                stands for (any C expression, normally a
+#                                MATRIX_COLOUR_* name from display.h)
+#     frame                      followed by MATRIX_NUM_ROWS lines of
+#                                <count> pixel characters, top row first
+#
+# See anim_stream.h for the stream format produced.
+
+import argparse
+import glob
+import os
+import sys
+
+# Must match ledmatrix.h
+MATRIX_NUM_COLUMNS = 16
+MATRIX_NUM_ROWS = 8
+
+# Must match anim_stream.h
+MAX_FRAMES = 255
+MAX_RUN = 16
+
+
+class AnimError(Exception):
+    pass
+
+
+class Animation:
+    def __init__(self, path):
+        self.path = path
+        self.name = None
+        self.first_column = None
+        self.num_columns = None
+        self.frame_time = None
+        self.colours = {}
+        # Each frame is a list of columns, each a list of pixel characters
+        # from the bottom row up
+        self.frames = []
+
+
+def parse(path):
+    anim = Animation(path)
+    with open(path) as f:
+        lines = [line.rstrip() for line in f]
+
+    def error(line_number, message):
+        raise AnimError("%s:%d: %s" % (path, line_number + 1, message))
+
+    i = 0
+    while i < len(lines):
+        words = lines[i].split()
+        if not words or words[0].startswith("#"):
+            i += 1
+            continue
+        keyword = words[0]
+        if keyword == "name" and len(words) == 2:
+            anim.name = words[1]
+        elif keyword == "columns" and len(words) == 3:
+            anim.first_column = int(words[1])
+            anim.num_columns = int(words[2])
+            if (anim.first_column < 0 or anim.num_columns < 1
+                    or anim.first_column + anim.num_columns
+                    > MATRIX_NUM_COLUMNS):
+                error(i, "columns must lie within the matrix")
+        elif keyword == "frame_time" and len(words) == 2:
+            anim.frame_time = int(words[1])
+            if not 0 < anim.frame_time <= 0xFFFF:
+                error(i, "frame_time must be 1 to 65535")
+        elif keyword == "colour" and len(words) >= 3 and len(words[1]) == 1:
+            anim.colours[words[1]] = " ".join(words[2:])
+        elif keyword == "frame" and len(words) == 1:
+            if anim.num_columns is None:
+                error(i, "columns must be given before the first frame")
+            rows = lines[i + 1:i + 1 + MATRIX_NUM_ROWS]
+            if len(rows) < MATRIX_NUM_ROWS:
+                error(i, "frame has fewer than %d rows" % MATRIX_NUM_ROWS)
+            for r, row in enumerate(rows):
+                if len(row) != anim.num_columns:
+                    error(i + 1 + r, "row should be %d pixels wide"
+                            % anim.num_columns)
+                for c in row:
+                    if c not in anim.colours:
+                        error(i + 1 + r, "no colour given for '%s'" % c)
+            # Rows are written top row first
+            anim.frames.append([[rows[MATRIX_NUM_ROWS - 1 - y][x]
+                    for y in range(MATRIX_NUM_ROWS)]
+                    for x in range(anim.num_columns)])
+            i += MATRIX_NUM_ROWS
+        else:
+            error(i, "can't understand '%s'" % lines[i])
+        i += 1
+
+    if anim.name is None or anim.frame_time is None or not anim.frames:
+        raise AnimError("%s: name, frame_time and at least one frame are "
+                "required" % path)
+    if len(anim.frames) > MAX_FRAMES:
+        raise AnimError("%s: more than %d frames" % (path, MAX_FRAMES))
+    return anim
+
+
+def encode_column(anim, column):
+    # Run length encode a column from the bottom row up
+    runs = []
+    y = 0
+    while y < MATRIX_NUM_ROWS:
+        length = 1
+        while (y + length < MATRIX_NUM_ROWS and length < MAX_RUN
+                and column[y + length] == column[y]):
+            length += 1
+        runs.append("ANIM_RUN(%d, %s)" % (length, anim.colours[column[y]]))
+        y += length
+    return runs
+
+
+def encode(anim):
+    # Returns the C source lines for the stream's bytes
+    out = []
+    out.append("\t%d, %d, %d,\t// first column, columns, frames"
+            % (anim.first_column, anim.num_columns, len(anim.frames)))
+    out.append("\t0x%02X, 0x%02X,\t// frame time %d ms"
+            % (anim.frame_time & 0xFF, anim.frame_time >> 8, anim.frame_time))
+    previous = None
+    for number, frame in enumerate(anim.frames):
+        # The first frame is sent whole, the rest as changes from the frame
+        # before
+        changed = 0
+        for x in range(anim.num_columns):
+            if previous is None or frame[x] != previous[x]:
+                changed |= 1 << x
+        out.append("\t0x%02X, 0x%02X,\t// frame %d"
+                % (changed & 0xFF, changed >> 8, number))
+        for x in range(anim.num_columns):
+            if changed & (1 << x):
+                out.append("\t\t" + ", ".join(encode_column(anim, frame[x]))
+                        + ",")
+        previous = frame
+    return out
+
+
+def stream_name(anim):
+    return anim.name + "_anim"
+
+
+def generate_source(anims, sources):
+    out = ["/*",
+            " * anim_data.c",
+            " *",
+            " * Animation streams generated by tools/animc.py from:",
+            ]
+    out += [" *     " + source for source in sources]
+    out += [" *",
+            " * Do not edit - edit the .anim files and rebuild instead.",
+            " */",
+            "",
+            "#include \"anim_data.h\"",
+            "#include <stdint.h>",
+            "#include <avr/pgmspace.h>",
+            "#include \"anim_stream.h\"",
+            "#include \"display.h\"",
+            ]
+    for anim in anims:
+        out.append("")
+        out.append("const uint8_t %s[] PROGMEM = {" % stream_name(anim))
+        out += encode(anim)
+        out.append("};")
+    return "\r\n".join(out) + "\r\n"
+
+
+def generate_header(anims):
+    out = ["/*",
+            " * anim_data.h",
+            " *",
+            " * Animation streams generated by tools/animc.py. Play them with",
+            " * anim_stream_start() (see anim_stream.h).",
+            " *",
+            " * Do not edit - edit the .anim files and rebuild instead.",
+            " */",
+            "",
+            "#ifndef ANIM_DATA_H_",
+            "#define ANIM_DATA_H_",
+            "",
+            "#include <stdint.h>",
+            "#include <avr/pgmspace.h>",
+            "",
+            ]
+    for anim in anims:
+        out.append("extern const uint8_t %s[] PROGMEM;" % stream_name(anim))
+    out += ["", "#endif /* ANIM_DATA_H_ */"]
+    return "\r\n".join(out) + "\r\n"
+
+
+def write_if_changed(path, text):
+    try:
+        with open(path, "rb") as f:
+            if f.read() == text.encode():
+                return
+    except IOError:
+        pass
+    with open(path, "wb") as f:
+        f.write(text.encode())
+
+
+def main():
+    parser = argparse.ArgumentParser(
+            description="Compile LED matrix animations into flash streams")
+    parser.add_argument("-o", "--output", default=".",
+            help="directory to write anim_data.c and anim_data.h to")
+    parser.add_argument("anims", nargs="+",
+            help=".anim files (wildcards allowed)")
+    args = parser.parse_args()
+
+    paths = set()
+    for pattern in args.anims:
+        if glob.has_magic(pattern):
+            matches = glob.glob(pattern)
+            if not matches:
+                sys.stderr.write("animc: no files match %s\n" % pattern)
+                return 1
+            paths.update(matches)
+        else:
+            paths.add(pattern)
+    paths = sorted(paths)
+
+    try:
+        anims = [parse(path) for path in paths]
+    except (AnimError, ValueError, IOError) as e:
+        sys.stderr.write("animc: %s\n" % e)
+        return 1
+
+    sources = [os.path.relpath(path, args.output).replace(os.sep, "/")
+            for path in paths]
+    write_if_changed(os.path.join(args.output, "anim_data.c"),
+            generate_source(anims, sources))
+    write_if_changed(os.path.join(args.output, "anim_data.h"),
+            generate_header(anims))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())